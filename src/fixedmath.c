@@ -0,0 +1,102 @@
+/*
+ * Copyright(c) 2016 Mathias Fiedler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ *     The above copyright notice and this permission notice shall be included
+ *     in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "fixedmath.h"
+
+#include <stdbool.h>
+
+// root of a normalized value from its top byte k + 64, sqrt(k + 64.5) * 16
+static const uint8_t sqrt_estimate[192] = {
+    128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139,
+    140, 141, 142, 143, 144, 144, 145, 146, 147, 148, 149, 150,
+    151, 151, 152, 153, 154, 155, 156, 156, 157, 158, 159, 160,
+    160, 161, 162, 163, 164, 164, 165, 166, 167, 167, 168, 169,
+    170, 170, 171, 172, 173, 173, 174, 175, 176, 176, 177, 178,
+    179, 179, 180, 181, 181, 182, 183, 183, 184, 185, 186, 186,
+    187, 188, 188, 189, 190, 190, 191, 192, 192, 193, 194, 194,
+    195, 196, 196, 197, 198, 198, 199, 200, 200, 201, 201, 202,
+    203, 203, 204, 205, 205, 206, 206, 207, 208, 208, 209, 210,
+    210, 211, 211, 212, 213, 213, 214, 214, 215, 216, 216, 217,
+    217, 218, 219, 219, 220, 220, 221, 221, 222, 223, 223, 224,
+    224, 225, 225, 226, 227, 227, 228, 228, 229, 229, 230, 230,
+    231, 232, 232, 233, 233, 234, 234, 235, 235, 236, 237, 237,
+    238, 238, 239, 239, 240, 240, 241, 241, 242, 242, 243, 243,
+    244, 244, 245, 246, 246, 247, 247, 248, 248, 249, 249, 250,
+    250, 251, 251, 252, 252, 253, 253, 254, 254, 255, 255, 255,
+};
+
+int32_t sqrti(int32_t i)
+{
+    if (i <= 0) return 0;
+
+    // normalize to [2^30, 2^32) by an even shift, so the root shifts by half
+    int s = __builtin_clz((uint32_t)i) & ~1;
+    uint32_t n = (uint32_t)i << s;
+    uint32_t r = (uint32_t)sqrt_estimate[(n >> 24) - 64] << 8;
+
+    // one Newton step leaves an error of at most a few units
+    r = (r + n / r) >> 1;
+    r >>= s / 2;
+
+    while (r * r > (uint32_t)i) --r;
+    while ((r + 1) * (r + 1) <= (uint32_t)i) ++r;
+    return (int32_t)r;
+}
+
+// atan(k / 32) for k = 0..32
+static const uint16_t atan_table[33] = {
+    0, 326, 651, 975, 1297, 1617, 1933, 2246, 2555, 2860, 3159,
+    3453, 3742, 4025, 4302, 4572, 4836, 5094, 5344, 5589, 5826, 6058,
+    6282, 6500, 6712, 6917, 7117, 7310, 7498, 7679, 7856, 8026, 8192,
+};
+
+int32_t atan2i(int32_t y, int32_t x)
+{
+    uint32_t ax = x < 0 ? -(uint32_t)x : (uint32_t)x;
+    uint32_t ay = y < 0 ? -(uint32_t)y : (uint32_t)y;
+    if (ax == 0 && ay == 0) return 0;
+
+    // first octant, tangent t in [0, 1] with 15 fractional bits
+    bool swap = ay > ax;
+    if (swap)
+    {
+        uint32_t tmp = ax;
+        ax = ay;
+        ay = tmp;
+    }
+    while (ax >= 0x10000)
+    {
+        ax >>= 1;
+        ay >>= 1;
+    }
+    uint32_t t = (ay << 15) / ax;
+
+    int k = t >> 10;
+    int32_t a = atan_table[k];
+    if (k < 32)
+        a += ((atan_table[k + 1] - a) * (int32_t)(t & 0x3FF) + 0x200) >> 10;
+
+    if (swap) a = 0x4000 - a;
+    if (x < 0) a = 0x8000 - a;
+    if (y < 0) a = 0x10000 - a;
+    return a & 0xFFFF;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright(c) 2016 Mathias Fiedler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ *     The above copyright notice and this permission notice shall be included
+ *     in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FIXEDMATH_H
+#define FIXEDMATH_H
+
+#include <stdint.h>
+
+// floor of the square root, for 0 <= i < 2^31
+int32_t sqrti(int32_t i);
+
+// angle of (x, y) in [0, 0x10000), the units of TRIG_MAX_ANGLE
+int32_t atan2i(int32_t y, int32_t x);
+
+/*
+ * Division by a divisor d > 0 which is used many times, as a multiplication
+ * with m = ceil(2^shift / d). Exact for 0 <= n < 2^30. Negative n only keep
+ * their sign, the result may be one below floor(n / d), -2 for n = -d, which
+ * the circle kernels treat the same as any uncovered pixel.
+ */
+struct recip
+{
+    uint32_t m;
+    int shift;
+};
+
+static inline struct recip recip_init(int32_t d)
+{
+    // 2^shift / d is in (2^30, 2^31]
+    int shift = 31 + (31 - __builtin_clz((uint32_t)d));
+    struct recip r = {
+        .m = (uint32_t)((((uint64_t)1 << shift) - 1) / (uint32_t)d + 1),
+        .shift = shift,
+    };
+    return r;
+}
+
+static inline int32_t recip_div(int32_t n, struct recip r)
+{
+    return (int32_t)(((int64_t)n * r.m) >> r.shift);
+}
+
+#endif
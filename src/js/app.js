@@ -11,17 +11,88 @@ var locationOptions = {
   timeout: 60000, // 1min
 };
 
-function locationSuccess(pos) {
-  console.log('lat= ' + pos.coords.latitude + ' lon= ' + pos.coords.longitude);
+const TRIG_MAX_ANGLE = 0x10000;
+// the watch ignores position changes up to 0.5 degree
+const LOCATION_TOLERANCE = TRIG_MAX_ANGLE / 720;
+// a cached position is used without a new fix for 3h
+const LOCATION_CACHE_AGE = 3 * 3600000;
 
-  const TRIG_MAX_ANGLE = 0x10000;
+// precompute sunrise and sunset on the phone, so the watch skips its own
+// calculation, see SUNTIMES_DAYS
+const SEND_SUNTIMES = true;
+const SUNTIMES_DAYS = 7;
+// sent again when the watch has less days left
+const SUNTIMES_RENEW_DAYS = 2;
+const SUN_ALWAYS_UP = -0x8000;
+const SUN_NEVER_UP = 0x7FFF;
 
-  var loc = {
-      'longitude': Math.round(pos.coords.longitude * TRIG_MAX_ANGLE / 360),
-      'latitude': Math.round(pos.coords.latitude * TRIG_MAX_ANGLE / 360),
+function toRadians(deg) {
+  return deg * Math.PI / 180;
+}
+
+// sunrise and sunset in minutes since midnight UTC of the given UTC date
+function sunTimes(date, lat, lon) {
+  var n = Math.round(date / 86400000 + 2440587.5 - 2451545.0 + 0.0008);
+  var j = n - lon / 360;
+  var m = (357.5291 + 0.98560028 * j) % 360;
+  var c = 1.9148 * Math.sin(toRadians(m)) + 0.02 * Math.sin(toRadians(2 * m)) +
+    0.0003 * Math.sin(toRadians(3 * m));
+  var l = toRadians((m + c + 180 + 102.9372) % 360);
+  var transit = 2451545.0 + j + 0.0053 * Math.sin(toRadians(m)) -
+    0.0069 * Math.sin(2 * l);
+  var sindecl = Math.sin(l) * Math.sin(toRadians(23.44));
+  var cosdecl = Math.cos(Math.asin(sindecl));
+  var cosh = (Math.sin(toRadians(-0.833)) - Math.sin(toRadians(lat)) * sindecl) /
+    (Math.cos(toRadians(lat)) * cosdecl);
+  if (cosh < -1) return [SUN_ALWAYS_UP, SUN_ALWAYS_UP];
+  if (cosh > 1) return [SUN_NEVER_UP, SUN_NEVER_UP];
+
+  var h = Math.acos(cosh) / (2 * Math.PI);
+  var toMinutes = function(jd) {
+    return Math.round(((jd - 2440587.5) * 86400000 - date) / 60000);
+  };
+  return [toMinutes(transit - h), toMinutes(transit + h)];
+}
+
+// year and day of year like struct tm, followed by the sun times of the
+// local days from today on, as little endian int16
+function packSunTimes(lat, lon) {
+  var now = new Date();
+  var start = Date.UTC(now.getFullYear(), 0, 1);
+  var yday = Math.round((Date.UTC(now.getFullYear(), now.getMonth(),
+                                  now.getDate()) - start) / 86400000);
+  var values = [now.getFullYear() - 1900, yday];
+  for (var i = 0; i < SUNTIMES_DAYS; ++i) {
+    var date = Date.UTC(now.getFullYear(), now.getMonth(), now.getDate() + i);
+    values = values.concat(sunTimes(date, lat, lon));
   }
+  var bytes = [];
+  for (var k = 0; k < values.length; ++k) {
+    bytes.push(values[k] & 0xFF, (values[k] >> 8) & 0xFF);
+  }
+  return bytes;
+}
 
-  Pebble.sendAppMessage(loc,
+function sendLocation(loc, watch) {
+  var moved = Math.abs(loc.longitude - watch.longitude) > LOCATION_TOLERANCE ||
+    Math.abs(loc.latitude - watch.latitude) > LOCATION_TOLERANCE;
+  var renew = SEND_SUNTIMES && watch.suntimes < SUNTIMES_RENEW_DAYS;
+  if (!moved && !renew) {
+    console.log('location unchanged');
+    return;
+  }
+
+  var msg = {};
+  if (moved) {
+    msg['longitude'] = loc.longitude;
+    msg['latitude'] = loc.latitude;
+  }
+  if (SEND_SUNTIMES) {
+    msg['suntimes'] = packSunTimes(loc.latitude * 360 / TRIG_MAX_ANGLE,
+                                   loc.longitude * 360 / TRIG_MAX_ANGLE);
+  }
+
+  Pebble.sendAppMessage(msg,
     function(e) {
       console.log('Send successful.');
     },
@@ -31,10 +102,36 @@ function locationSuccess(pos) {
   );
 }
 
+function locationSuccess(pos, watch) {
+  console.log('lat= ' + pos.coords.latitude + ' lon= ' + pos.coords.longitude);
+
+  var loc = {
+      'longitude': Math.round(pos.coords.longitude * TRIG_MAX_ANGLE / 360),
+      'latitude': Math.round(pos.coords.latitude * TRIG_MAX_ANGLE / 360),
+      'time': Date.now(),
+  };
+  localStorage.setItem('location', JSON.stringify(loc));
+  sendLocation(loc, watch);
+}
+
 function locationError(err) {
   console.log('location error (' + err.code + '): ' + err.message);
 }
 
+// the watch sends its own position and the days of sun times it has left
+function requestLocation(watch) {
+  var cached = JSON.parse(localStorage.getItem('location') || 'null');
+  if (cached && Date.now() - cached.time < LOCATION_CACHE_AGE) {
+    sendLocation(cached, watch);
+    return;
+  }
+  navigator.geolocation.getCurrentPosition(
+    function(pos) {
+      locationSuccess(pos, watch);
+    },
+    locationError, locationOptions);
+}
+
 Pebble.addEventListener('ready',
   function(e) {
     Pebble.sendAppMessage({'ready': 1},
@@ -48,15 +145,84 @@ Pebble.addEventListener('ready',
   }
 );
 
+// render stages and histogram buckets of a profile message, see PROFILE
+var profileStages = [
+  'setup', 'clear', 'day', 'status', 'ticks', 'numbers', 'encode',
+  'hour', 'min', 'sec', 'caps'
+];
+var profileBuckets = ['0', '1', '2-3', '4-7', '8-15', '16-31', '32-63', '64+'];
+
+function logProfile(data) {
+  var n = profileBuckets.length;
+  var stages = {};
+  for (var i = 0; i < profileStages.length; ++i) {
+    var hist = {};
+    for (var j = 0; j < n; ++j) {
+      if (data[i * n + j]) hist[profileBuckets[j]] = data[i * n + j];
+    }
+    stages[profileStages[i]] = hist;
+  }
+  console.log('profile: ' + JSON.stringify({'ms': stages}));
+}
+
+// frames of today and yesterday in each refresh mode, see REFRESH_SECONDS
+var refreshModes = ['seconds', 'minutes', 'resting'];
+
+function logFrames(data) {
+  var days = ['today', 'yesterday'];
+  var frames = {};
+  for (var d = 0; d < days.length; ++d) {
+    var modes = {};
+    for (var i = 0; i < refreshModes.length; ++i) {
+      var k = (d * refreshModes.length + i) * 4;
+      modes[refreshModes[i]] =
+        (data[k] | (data[k + 1] << 8) | (data[k + 2] << 16) | (data[k + 3] << 24)) >>> 0;
+    }
+    frames[days[d]] = modes;
+  }
+  console.log('frames: ' + JSON.stringify(frames));
+}
+
+// queued messages and totals of the watch's outbox
+function logOutbox(data) {
+  if (data == null) return;
+  var names = ['queued', 'sent', 'failed', 'dropped'];
+  var stats = {};
+  for (var i = 0; i < names.length; ++i) {
+    stats[names[i]] = data[i * 2] | (data[i * 2 + 1] << 8);
+  }
+  console.log('outbox: ' + JSON.stringify(stats));
+}
+
+// Clay opens the page, this only asks the watch for its frame counts
+Pebble.addEventListener('showConfiguration',
+  function(e) {
+    Pebble.sendAppMessage({'frames': 0});
+  }
+);
+
 Pebble.addEventListener('appmessage',
     function(e) {
+      if (e.payload['profile'] != null) {
+        logProfile(e.payload['profile']);
+        return;
+      }
+      if (e.payload['frames'] != null) {
+        logFrames(e.payload['frames']);
+        logOutbox(e.payload['outbox']);
+        return;
+      }
       console.log("appmsg: " + JSON.stringify(e.payload));
       var r = e.payload['request'];
       if (r != null) {
         switch (r) {
         case 0:
           // Request current position
-          navigator.geolocation.getCurrentPosition(locationSuccess, locationError, locationOptions);
+          requestLocation({
+            'longitude': e.payload['longitude'],
+            'latitude': e.payload['latitude'],
+            'suntimes': e.payload['suntimes'] || 0,
+          });
           break;
         }
       }
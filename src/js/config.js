@@ -102,6 +102,22 @@ module.exports = [{
         "messageKey": "outline",
         "label": "Outline",
         "defaultValue": true
+    }, {
+        "type": "radiogroup",
+        "messageKey": "antialias",
+        "label": "Anti-aliasing",
+        "description": "Auto draws the hands without anti-aliasing while the second hand sweeps, on low battery or when rendering is too slow.",
+        "defaultValue": "0",
+        "options": [{
+            "label": "Auto",
+            "value": 0
+        }, {
+            "label": "Always",
+            "value": 1
+        }, {
+            "label": "Never",
+            "value": 2
+        }]
     }, {
         "type": "radiogroup",
         "messageKey": "colorflip",
@@ -239,6 +255,24 @@ module.exports = [{
         "min": 1,
         "max": 15,
         "step": 1
+    }, {
+        "type": "radiogroup",
+        "messageKey": "hourshape",
+        "label": "Shape",
+        "defaultValue": "0",
+        "options": [{
+            "label": "Bar",
+            "value": 0
+        }, {
+            "label": "Tapered",
+            "value": 1
+        }, {
+            "label": "Arrow",
+            "value": 2
+        }, {
+            "label": "Lozenge",
+            "value": 3
+        }]
     }]
 }, {
     "type": "section",
@@ -269,6 +303,24 @@ module.exports = [{
         "min": 1,
         "max": 15,
         "step": 1
+    }, {
+        "type": "radiogroup",
+        "messageKey": "minshape",
+        "label": "Shape",
+        "defaultValue": "0",
+        "options": [{
+            "label": "Bar",
+            "value": 0
+        }, {
+            "label": "Tapered",
+            "value": 1
+        }, {
+            "label": "Arrow",
+            "value": 2
+        }, {
+            "label": "Lozenge",
+            "value": 3
+        }]
     }, {
         "type": "slider",
         "messageKey": "centerwidth",
@@ -307,6 +359,28 @@ module.exports = [{
         "min": 5,
         "max": 120,
         "step": 5
+    }, {
+        "type": "radiogroup",
+        "messageKey": "secsweep",
+        "label": "Motion",
+        "description": "A sweeping second hand falls back to fewer frames or ticking when rendering is too slow or the battery is low.",
+        "defaultValue": "0",
+        "options": [{
+            "label": "Tick",
+            "value": 0
+        }, {
+            "label": "Sweep 4 fps",
+            "value": 4
+        }, {
+            "label": "Sweep 6 fps",
+            "value": 6
+        }, {
+            "label": "Sweep 8 fps",
+            "value": 8
+        }, {
+            "label": "Sweep 10 fps",
+            "value": 10
+        }]
     }, {
         "type": "slider",
         "messageKey": "seclen",
@@ -340,6 +414,32 @@ module.exports = [{
         "max": 32,
         "step": 1
     }]
+}, {
+    "type": "section",
+    "items": [{
+        "type": "heading",
+        "defaultValue": "Dial"
+    }, {
+        "type": "radiogroup",
+        "messageKey": "dialshape",
+        "label": "Shape",
+        "defaultValue": "0",
+        "options": [{
+            "label": "Round",
+            "value": 0
+        }, {
+            "label": "Rectangle",
+            "value": 1
+        }]
+    }, {
+        "type": "slider",
+        "messageKey": "dialcorner",
+        "defaultValue": 20,
+        "label": "Corner Radius",
+        "min": 0,
+        "max": 60,
+        "step": 1
+    }]
 }, {
     "type": "section",
     "items": [{
@@ -45,6 +45,13 @@ enum
     COLORFLIP_KEY,
     LONGITUDE_KEY,
     LATITUDE_KEY,
+    ROUNDEDRECT_KEY,
+    SWEEP_KEY,
+    ANTIALIAS_KEY,
+    // no longer written, the baselines of the bench are kept by test/bench
+    BENCH_KEY,
+    SUNTIMES_KEY,
+    WARMSTART_KEY,
 };
 
 enum
@@ -52,17 +59,178 @@ enum
     REQUEST_LOCATION,
 };
 
+// types of outgoing messages, at most one of each is queued
+enum
+{
+    OUTBOX_LOCATION,
+    OUTBOX_FRAMES,
+    OUTBOX_PROFILE,
+};
+
+// the first retry of a failed message, each further one waits twice as long
+#define OUTBOX_RETRY_MS 1000
+#define OUTBOX_MAX_RETRIES 6
+
 #define INVALID_DEGREE (TRIG_MAX_ANGLE * 2)
 
-#define NUM_MESSAGE_KEYS    46
+// days of sun times precomputed by the phone
+#define SUNTIMES_DAYS 7
+// sun times of a day without sunrise or sunset
+#define SUN_ALWAYS_UP INT16_MIN
+#define SUN_NEVER_UP INT16_MAX
+
+#define NUM_MESSAGE_KEYS    52
 
+// the flags below can be set for the host builds in test/
+#ifndef DEMO
 #define DEMO 0
+#endif
+#ifndef BENCH
 #define BENCH 0
+#endif
+// per stage render time histograms, sent to the phone
+#ifndef PROFILE
+#define PROFILE 0
+#endif
+// logs the time to the first frame, split into its phases
+#ifndef STARTUP
+#define STARTUP 0
+#endif
+
+// 1 records the inputs to a ring buffer in persist storage, 2 replays them
+#ifndef TRACE
+#define TRACE 0
+#endif
+
+#if BENCH
+// every minute of the day and every second of one minute are rendered with
+// the configured settings and with each of these toggled, test/bench compares
+// the frame times of the host with a baseline
+enum
+{
+    BENCH_CONFIG,
+    BENCH_SECONDS,
+    BENCH_OUTLINE,
+    BENCH_HOUR_BELOW,
+    BENCH_COLOR_FLIP,
+    BENCH_FONTS,
+    BENCH_DIAL_NUMBERS,
+    BENCH_STATUS,
+#if RASTER_8BIT && RASTER_1BIT
+    // the 1 bit kernels, drawing to an offscreen bitmap
+    BENCH_1BIT,
+#endif
+    NUM_BENCH_PRESETS
+};
+
+#define BENCH_FRAMES (24 * 60 + 60)
+// frames per redraw
+#define BENCH_CHUNK 60
+#endif
+
+// a sweeping second hand may spend 1 / SWEEP_BUDGET of each frame rendering
+#define SWEEP_BUDGET 4
+// its frame rate is lowered after this many frames over budget in a row, and
+// raised again after this many with room for the next higher rate
+#define SWEEP_OVER_FRAMES 3
+#define SWEEP_UNDER_FRAMES 60
+// the lowest frame rate before falling back to ticking
+#define SWEEP_MIN_FPS 4
+// and stops below this battery charge, unless charging
+#define SWEEP_MIN_BATTERY 30
+
+// in auto mode, a slower frame turns off AA of the hands until the next minute
+#define AA_BUDGET_MS 40
+// as does a battery charge below this, unless charging
+#define AA_MIN_BATTERY 20
+
+// a Bluetooth connection change is shown, and vibrates, once it held this long
+#define CONNECTION_DEBOUNCE_MS 3000
+
+// the second hand rests after this many minutes without taps or steps
+#define IDLE_MINUTES 30
+// or after a tap shows it this long while asleep or in quiet time
+#define WAKE_MINUTES 2
+
+// frames of each refresh mode are counted per day
+enum
+{
+    REFRESH_SECONDS,
+    REFRESH_MINUTES,
+    // minutes while the second hand rests
+    REFRESH_RESTING,
+    NUM_REFRESH_MODES
+};
+
+#if TRACE
+enum
+{
+    TRACE_WRAP,
+    TRACE_TICK,
+    TRACE_CONNECTION,
+    TRACE_MESSAGE,
+    TRACE_TAP,
+    TRACE_BATTERY,
+};
+
+// persist keys of the trace header and its chunks, apart from the settings
+#define TRACE_PERSIST_KEY 0x1000
+#define TRACE_CHUNKS 8
+#define TRACE_SIZE (TRACE_CHUNKS * PERSIST_DATA_MAX_LENGTH)
+// records are a type, a 16 bit length and the payload
+#define TRACE_RECORD_HEADER 3
+// delay between replayed inputs, leaves time to draw their frames
+#define TRACE_REPLAY_MS 100
+
+struct trace_tick
+{
+    int32_t gmtoff;
+    int16_t year, yday;
+    int8_t sec, min, hour, mday, mon, wday;
+    uint8_t units;
+};
+#endif
+
+#if PROFILE
+enum
+{
+    STAGE_SETUP,
+    STAGE_CLEAR,
+    STAGE_DAY,
+    STAGE_STATUS,
+    STAGE_TICKS,
+    STAGE_NUMBERS,
+    STAGE_ENCODE,
+    STAGE_HOUR,
+    STAGE_MIN,
+    STAGE_SEC,
+    STAGE_CAPS,
+    NUM_STAGES
+};
+
+// buckets of 0, 1, 2-3, 4-7, ... and 64+ ms
+#define PROFILE_BUCKETS 8
+// frames per histogram, and histograms kept until sent
+#define PROFILE_FRAMES 60
+#define PROFILE_SLOTS 4
+#endif
+
+#if STARTUP
+enum
+{
+    STARTUP_INIT,
+    STARTUP_SETTINGS,
+    STARTUP_WINDOW,
+    STARTUP_FRAME,
+    NUM_STARTUP_MARKS
+};
+#endif
 
 struct hand_conf
 {
     int32_t w, r0, r1;
     uint8_t col;
+    uint8_t shape;
 };
 
 struct tick_conf
@@ -72,14 +240,101 @@ struct tick_conf
     uint8_t show;
 };
 
+enum
+{
+    TICK_RECT,
+    TICK_HSTRIP,
+    TICK_VSTRIP,
+};
+
+// outer end of a tick on the dial edge, pointing inwards
+struct tick_anchor
+{
+    int16_t px, py;
+    int16_t dx, dy;
+    uint8_t kind;
+};
+
+// settings the dial layout depends on
+struct dial_key
+{
+    int16_t w2, h2;
+    uint8_t rounded_rect;
+    // distance of dial number centers from the edge
+    int32_t inset;
+};
+
+// time dependent state of everything in the static layer, -1 if not shown,
+// the second marker is drawn with the hands since it moves every 5 seconds
+struct static_key
+{
+    int16_t w2, h2;
+    int16_t day_px, day_py;
+    int8_t hour_tick, hour_mark;
+    int8_t min_first, min_last;
+    int8_t hour_number, hour_number_pos, min_number;
+    // sector of disconnected and battery icon
+    int8_t status[2];
+    uint8_t battery;
+};
+
+// everything the cached day sprite depends on, colors are the processed ones
+struct day_key
+{
+    uint32_t colors;
+    uint8_t today, sunday, weekday;
+    uint8_t ofweek, ofmonth, font;
+    // pixel format and the parity of the position for 1 bit
+    uint8_t bits, parity;
+};
+
 enum
 {
     BLOCKY_FONT,
     BLOCKY_SMALL_FONT,
     SMOOTH_FONT,
     SMOOTH_SMALL_FONT,
+    // not decoded, since its feature is off
+    NO_FONT = 0xFF,
 };
 
+enum
+{
+    HAND_RECT,
+    HAND_TAPERED,
+    HAND_ARROW,
+    HAND_LOZENGE,
+};
+
+enum
+{
+    AA_AUTO,
+    AA_ALWAYS,
+    AA_NEVER,
+};
+
+// why a frame is drawn, the reasons of all events before a frame are combined
+enum
+{
+    // only the hands moved
+    REDRAW_SECOND = 0x01,
+    // the static layer changes if its key does
+    REDRAW_MINUTE = 0x02,
+    REDRAW_STATUS = 0x04,
+    // the static layer is redrawn
+    REDRAW_DAY = 0x08,
+    REDRAW_CONFIG = 0x10,
+    REDRAW_LAYOUT = 0x20,
+    // the background changed, so everything is cleared
+    REDRAW_PALETTE = 0x40,
+    // assumed for redraws of the system
+    REDRAW_ALL = 0x7F,
+};
+
+#define REDRAW_KEY (REDRAW_MINUTE | REDRAW_STATUS)
+#define REDRAW_STATICS (REDRAW_DAY | REDRAW_CONFIG | REDRAW_LAYOUT | \
+                        REDRAW_PALETTE)
+
 enum
 {
     NO_COLOR_FLIP,
@@ -93,6 +348,18 @@ struct
 
     int ready;
 
+    // bits of the queued message types and of the one being sent
+    struct {
+        uint8_t queued;
+        uint8_t sending;
+        uint8_t retries;
+        AppTimer *timer;
+        // totals for diagnostics
+        uint16_t sent, failed, dropped;
+    } outbox;
+    // reasons of the next frame
+    uint8_t redraw;
+
     uint8_t bgcol;
     int hour, min, sec;
     int dmin;
@@ -101,6 +368,27 @@ struct
 
     int showsec;
     int seccount;
+
+    struct {
+        // minutes since the last tap or steps
+        uint16_t idle;
+        bool asleep;
+        bool resting;
+        int32_t steps;
+        // frames of today and yesterday
+        uint32_t frames[2][NUM_REFRESH_MODES];
+    } refresh;
+    // milliseconds into the current second while the second hand sweeps
+    int ms;
+
+    struct {
+        // configured and governed frame rate, 0 ticks once per second
+        uint8_t fps;
+        uint8_t rate;
+        // frames in a row over, or under, the budget
+        uint8_t over, under;
+        AppTimer *timer;
+    } sweep;
     int num_scanlines;
     struct scanline *scanlines;
 
@@ -111,14 +399,20 @@ struct
 
     bool outline;
     bool hourhand_below;
+
+    struct {
+        uint8_t mode;
+        bool overrun;
+    } aa;
     uint8_t last_tick;
 
     struct {
         struct bmpset font;
         int ofweek, ofmonth, ofyear;
-        int px, py;
-        bool update;
+        int year;
         bool show;
+        GBitmap *sprite;
+        struct day_key key;
     } day;
 
     struct
@@ -133,7 +427,43 @@ struct
 
     struct tick_conf hour_tick, min_tick;
 
-    // uint8_t rounded_rect;
+    // corner radius of a rectangular dial, 0 for a round one
+    uint8_t rounded_rect;
+
+    // derived from the unobstructed bounds
+    struct {
+        GRect bounds;
+        int16_t w2, h2;
+        // max radius
+        int32_t mr;
+        // distance of day and status icon slots from the center
+        int16_t slot_r;
+    } layout;
+
+    struct {
+        struct dial_key key;
+        struct tick_anchor ticks[60];
+        // dial number centers at every fifth tick
+        struct {
+            int16_t x, y;
+        } numbers[12];
+    } dial;
+
+    // ticks, dial numbers, day and status icons on the background, stored
+    // as (color, length) runs of each row, or as a copy of 1 bit rows
+    struct {
+        struct static_key key;
+        // parts of each row covered by static content
+        struct scanline *spans;
+        uint16_t *rows;
+        uint8_t *runs;
+        // rows in the layer and allocated ones
+        int h;
+        int num_rows;
+        int size;
+        bool bits;
+        bool valid;
+    } statics;
 
     struct {
         uint8_t col;
@@ -146,10 +476,18 @@ struct
     } fontconf;
 
     struct bmpset dialfont;
+    // fonts in day.font and dialfont, not persisted with fontconf
+    struct {
+        uint8_t day;
+        uint8_t dial;
+    } loaded_fonts;
 
     struct {
         BatteryChargeState batstate;
         bool connected;
+        // last reported connection, applied by the debounce timer
+        bool reported;
+        AppTimer *debounce;
     } status;
 
     struct {
@@ -160,8 +498,73 @@ struct
     } statusconf;
 
     int sunrise, sunset;
+    // sunrise and sunset of the days from yday on, in minutes since midnight
+    // UTC, so they stay valid when the UTC offset changes
+    struct {
+        int16_t year, yday;
+        int16_t times[SUNTIMES_DAYS][2];
+    } suntimes;
+
+    // sun times of the last launch, reused while the hash of what they were
+    // derived from matches
+    struct {
+        uint32_t hash;
+        int16_t sunrise, sunset;
+    } warm;
+    bool warm_changed;
+
     uint8_t flip_colors_conf;
     bool flip_colors;
+
+#if TRACE
+    struct {
+        // oldest record and the end of the newest one
+        uint16_t tail, head;
+        uint8_t dirty;
+        bool replaying;
+        uint8_t buf[TRACE_SIZE];
+        AppTimer *timer;
+    } trace;
+#endif
+
+#if BENCH
+    struct {
+        uint8_t preset;
+        uint16_t frame;
+        // frames per ms of render time
+        uint16_t hist[64];
+        uint32_t ms;
+        uint32_t pixels;
+        // settings replaced by a preset
+        int8_t showsec;
+        uint8_t warnlevel;
+        GBitmap *bitmap;
+    } bench;
+#endif
+
+#if PROFILE
+    struct {
+        uint16_t t;
+        // time spent in each stage of this frame and the stages run
+        uint16_t dt[NUM_STAGES];
+        uint16_t mask;
+        uint8_t frames;
+        // histogram being filled and the next to send
+        uint8_t head, sent;
+        uint8_t hist[PROFILE_SLOTS][NUM_STAGES][PROFILE_BUCKETS];
+    } prof;
+#endif
+
+#if STARTUP
+    struct {
+        uint32_t t[NUM_STARTUP_MARKS];
+        // time spent decoding resources until the first frame
+        uint16_t resources;
+        // whether derived state of the last launch was reused
+        bool warm;
+        bool done;
+    } startup;
+#endif
 } g;
 
 static uint8_t process_color(uint8_t col)
@@ -203,31 +606,456 @@ static inline void clear_bg(void)
 {
     free(g.scanlines);
     g.scanlines = NULL;
+    g.statics.valid = false;
+}
+
+static void request_redraw(uint8_t reasons)
+{
+    g.redraw |= reasons;
+    layer_mark_dirty(window_get_root_layer(g.window));
+}
+
+static inline void update_scanlines(struct scanline *scanlines,
+                                    int y0, int y1, int x0, int x1)
+{
+    int start = x0 >> 2;
+    int end = (x1 + 3) >> 2;
+    for (int y = y0; y < y1; ++y)
+    {
+        struct scanline *line = scanlines + y;
+        if (line->start > start) line->start = start;
+        if (line->end < end) line->end = end;
+    }
+}
+
+// days of sun times left from today on
+static int suntimes_left(void)
+{
+    int i = g.day.ofyear - g.suntimes.yday;
+    if (g.suntimes.year != g.day.year || i < 0 || i >= SUNTIMES_DAYS)
+        return 0;
+    return SUNTIMES_DAYS - i;
+}
+
+// whether a queued message still has something to send, checked before the
+// outbox is opened, which only a send releases again
+static bool outbox_pending(int type)
+{
+#if PROFILE
+    if (type == OUTBOX_PROFILE)
+        return g.prof.sent != g.prof.head;
+#endif
+    return true;
+}
+
+// builds a queued message
+static void outbox_write(int type, DictionaryIterator *iter)
+{
+    switch (type)
+    {
+    case OUTBOX_LOCATION:
+        dict_write_int32(iter, MESSAGE_KEY_request, REQUEST_LOCATION);
+        // the phone only answers if the position moved past the tolerance
+        // or the sun times run out
+        dict_write_int32(iter, MESSAGE_KEY_longitude, g.lon);
+        dict_write_int32(iter, MESSAGE_KEY_latitude, g.lat);
+        dict_write_int32(iter, MESSAGE_KEY_suntimes, suntimes_left());
+        break;
+    case OUTBOX_FRAMES:
+    {
+        dict_write_data(iter, MESSAGE_KEY_frames,
+                        (const uint8_t *)g.refresh.frames,
+                        sizeof(g.refresh.frames));
+        uint16_t stats[] = {
+            __builtin_popcount(g.outbox.queued), g.outbox.sent,
+            g.outbox.failed, g.outbox.dropped,
+        };
+        dict_write_data(iter, MESSAGE_KEY_outbox, (const uint8_t *)stats,
+                        sizeof(stats));
+        break;
+    }
+#if PROFILE
+    case OUTBOX_PROFILE:
+        // the oldest histogram which was not overwritten
+        if ((uint8_t)(g.prof.head - g.prof.sent) > PROFILE_SLOTS - 1)
+            g.prof.sent = g.prof.head - (PROFILE_SLOTS - 1);
+        dict_write_data(iter, MESSAGE_KEY_profile,
+                        &g.prof.hist[g.prof.sent % PROFILE_SLOTS][0][0],
+                        sizeof(g.prof.hist[0]));
+        break;
+#endif
+    }
+}
+
+static void outbox_flush(void);
+
+static void outbox_timer_handler(void *data)
+{
+    g.outbox.timer = NULL;
+    outbox_flush();
+}
+
+// backs off exponentially, a message is dropped after OUTBOX_MAX_RETRIES
+static void outbox_retry(int type)
+{
+    ++g.outbox.failed;
+    if (++g.outbox.retries > OUTBOX_MAX_RETRIES)
+    {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "outbox: dropping message %d", type);
+        g.outbox.queued &= ~(1 << type);
+        g.outbox.retries = 0;
+        ++g.outbox.dropped;
+        outbox_flush();
+        return;
+    }
+    g.outbox.timer = app_timer_register(
+        OUTBOX_RETRY_MS << (g.outbox.retries - 1), outbox_timer_handler, NULL);
+}
+
+// sends the first queued message, once the phone is ready and nothing is
+// in flight or waiting for a retry
+static void outbox_flush(void)
+{
+    while (g.outbox.queued && g.ready && ! g.outbox.sending &&
+           ! g.outbox.timer)
+    {
+        int type = __builtin_ctz(g.outbox.queued);
+        if (! outbox_pending(type))
+        {
+            g.outbox.queued &= ~(1 << type);
+            continue;
+        }
+        DictionaryIterator *iter;
+        if (app_message_outbox_begin(&iter) != APP_MSG_OK)
+        {
+            outbox_retry(type);
+            return;
+        }
+        outbox_write(type, iter);
+        // sent all the same, nothing else releases the outbox
+        if (dict_write_end(iter) == 0)
+            APP_LOG(APP_LOG_LEVEL_ERROR, "outbox: failed to build message %d",
+                    type);
+        if (app_message_outbox_send() != APP_MSG_OK)
+        {
+            outbox_retry(type);
+            return;
+        }
+        g.outbox.queued &= ~(1 << type);
+        g.outbox.sending = 1 << type;
+    }
+}
+
+// queues a message, it replaces a queued one of the same type
+static void outbox_send(int type)
+{
+    g.outbox.queued |= 1 << type;
+    outbox_flush();
+}
+
+static void outbox_sent_handler(DictionaryIterator *iter, void *context)
+{
+    int type = __builtin_ctz(g.outbox.sending);
+    g.outbox.sending = 0;
+    g.outbox.retries = 0;
+    ++g.outbox.sent;
+#if PROFILE
+    // send the rest of the histograms
+    if (type == OUTBOX_PROFILE && ++g.prof.sent != g.prof.head)
+        g.outbox.queued |= 1 << OUTBOX_PROFILE;
+#else
+    (void)type;
+#endif
+    outbox_flush();
 }
 
-static void send_request(int request)
+static void outbox_failed_handler(DictionaryIterator *iter,
+                                  AppMessageResult reason, void *context)
 {
-    DictionaryIterator *iter;
-    AppMessageResult result = app_message_outbox_begin(&iter);
-    if (result != APP_MSG_OK) {
-        APP_LOG(APP_LOG_LEVEL_ERROR, "failed to create request message");
+    if (! g.outbox.sending)
         return;
+    int type = __builtin_ctz(g.outbox.sending);
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "outbox: message %d failed: %d", type,
+            (int)reason);
+    g.outbox.sending = 0;
+    g.outbox.queued |= 1 << type;
+    outbox_retry(type);
+}
+
+#if PROFILE
+#define PROFILE_START() (g.prof.t = time_ms(NULL, NULL))
+#define PROFILE_STAGE(S) profile_stage(S)
+#define PROFILE_FRAME() profile_frame()
+
+static void profile_stage(int stage)
+{
+    uint16_t t = time_ms(NULL, NULL);
+    g.prof.dt[stage] += t < g.prof.t ? t + 1000 - g.prof.t : t - g.prof.t;
+    g.prof.mask |= 1 << stage;
+    g.prof.t = t;
+}
+
+static void profile_frame(void)
+{
+    uint8_t (*hist)[PROFILE_BUCKETS] = g.prof.hist[g.prof.head % PROFILE_SLOTS];
+    for (int i = 0; i < NUM_STAGES; ++i)
+    {
+        if (g.prof.mask & (1 << i))
+        {
+            int b = g.prof.dt[i] ? 32 - __builtin_clz(g.prof.dt[i]) : 0;
+            if (b >= PROFILE_BUCKETS) b = PROFILE_BUCKETS - 1;
+            if (hist[i][b] < 255) ++hist[i][b];
+        }
+        g.prof.dt[i] = 0;
     }
-    dict_write_int32(iter, MESSAGE_KEY_request, request);
-    if (dict_write_end(iter) == 0)
-        APP_LOG(APP_LOG_LEVEL_ERROR, "failed to build request message");
+    g.prof.mask = 0;
+
+    if (++g.prof.frames == PROFILE_FRAMES)
+    {
+        g.prof.frames = 0;
+        ++g.prof.head;
+        memset(g.prof.hist[g.prof.head % PROFILE_SLOTS], 0,
+               sizeof(g.prof.hist[0]));
+        outbox_send(OUTBOX_PROFILE);
+    }
+}
+#else
+#define PROFILE_START()
+#define PROFILE_STAGE(S)
+#define PROFILE_FRAME()
+#endif
+
+#if STARTUP
+#define STARTUP_MARK(M) startup_mark(M)
+
+static uint32_t startup_ms(void)
+{
+    time_t s;
+    uint16_t ms;
+    time_ms(&s, &ms);
+    return (uint32_t)s * 1000 + ms;
+}
+
+static void startup_mark(int mark)
+{
+    if (g.startup.done) return;
+    g.startup.t[mark] = startup_ms();
+    if (mark != STARTUP_FRAME) return;
+
+    g.startup.done = true;
+    uint32_t *t = g.startup.t;
+    APP_LOG(APP_LOG_LEVEL_INFO,
+            "startup: settings %d, window %d, resources %d, first frame %d, "
+            "total %d ms, warm %d",
+            (int)(t[STARTUP_SETTINGS] - t[STARTUP_INIT]),
+            (int)(t[STARTUP_WINDOW] - t[STARTUP_SETTINGS]),
+            g.startup.resources,
+            (int)(t[STARTUP_FRAME] - t[STARTUP_WINDOW] - g.startup.resources),
+            (int)(t[STARTUP_FRAME] - t[STARTUP_INIT]), g.startup.warm);
+}
+#else
+#define STARTUP_MARK(M)
+#endif
+
+#if TRACE
+static int trace_next(int pos)
+{
+    if (pos >= TRACE_SIZE || g.trace.buf[pos] == TRACE_WRAP)
+        return 0;
+    pos += TRACE_RECORD_HEADER + g.trace.buf[pos + 1] +
+        (g.trace.buf[pos + 2] << 8);
+    return pos < TRACE_SIZE ? pos : 0;
+}
+
+static void trace_load(void)
+{
+    uint16_t header[2] = { 0, 0 };
+    persist_read_data(TRACE_PERSIST_KEY, header, sizeof(header));
+    g.trace.tail = header[0] < TRACE_SIZE ? header[0] : 0;
+    g.trace.head = header[1] < TRACE_SIZE ? header[1] : 0;
+    for (int i = 0; i < TRACE_CHUNKS; ++i)
+        persist_read_data(TRACE_PERSIST_KEY + 1 + i,
+                          g.trace.buf + i * PERSIST_DATA_MAX_LENGTH,
+                          PERSIST_DATA_MAX_LENGTH);
+    g.trace.dirty = 0;
+}
+
+#if TRACE == 1
+#define TRACE_INPUT(record) record
+
+// writes the changed chunks
+static void trace_flush(void)
+{
+    if (! g.trace.dirty)
+        return;
+    uint16_t header[2] = { g.trace.tail, g.trace.head };
+    persist_write_data(TRACE_PERSIST_KEY, header, sizeof(header));
+    for (int i = 0; i < TRACE_CHUNKS; ++i)
+        if (g.trace.dirty & (1 << i))
+            persist_write_data(TRACE_PERSIST_KEY + 1 + i,
+                               g.trace.buf + i * PERSIST_DATA_MAX_LENGTH,
+                               PERSIST_DATA_MAX_LENGTH);
+    g.trace.dirty = 0;
+}
+
+static void trace_write(int pos, const void *data, int n)
+{
+    memcpy(g.trace.buf + pos, data, n);
+    for (int i = pos / PERSIST_DATA_MAX_LENGTH;
+         i <= (pos + n - 1) / PERSIST_DATA_MAX_LENGTH; ++i)
+        g.trace.dirty |= 1 << i;
+}
 
-    result = app_message_outbox_send();
-    if (result != APP_MSG_OK) {
-        APP_LOG(APP_LOG_LEVEL_ERROR, "failed to send request");
+// appends a record, dropping the oldest ones in its way
+static void trace_record(int type, const void *data, int n)
+{
+    int head = g.trace.head;
+    int pos = head + TRACE_RECORD_HEADER + n > TRACE_SIZE ? 0 : head;
+    int end = pos + TRACE_RECORD_HEADER + n;
+    if (end > TRACE_SIZE)
         return;
+    int next = end < TRACE_SIZE ? end : 0;
+
+    // the tail must not end up at the new head, unless nothing is left
+    for (;;)
+    {
+        int t = g.trace.tail;
+        bool in_way = pos < head ? t >= head || t <= end :
+            (t >= pos && t <= end) || t == next;
+        if (t == head || ! in_way)
+            break;
+        g.trace.tail = trace_next(t);
+    }
+    if (g.trace.tail == head)
+        g.trace.tail = pos;
+
+    if (pos < head)
+    {
+        uint8_t wrap = TRACE_WRAP;
+        trace_write(head, &wrap, 1);
     }
+    uint8_t header[TRACE_RECORD_HEADER] = { type, n & 0xFF, n >> 8 };
+    trace_write(pos, header, TRACE_RECORD_HEADER);
+    trace_write(pos + TRACE_RECORD_HEADER, data, n);
+    g.trace.head = next;
+}
+
+static void trace_tick(const struct tm *t, TimeUnits units_changed)
+{
+    struct trace_tick tick = {
+        .gmtoff = t->tm_gmtoff,
+        .year = t->tm_year,
+        .yday = t->tm_yday,
+        .sec = t->tm_sec,
+        .min = t->tm_min,
+        .hour = t->tm_hour,
+        .mday = t->tm_mday,
+        .mon = t->tm_mon,
+        .wday = t->tm_wday,
+        .units = units_changed,
+    };
+    trace_record(TRACE_TICK, &tick, sizeof(tick));
+}
+
+static void trace_connection(bool connected)
+{
+    uint8_t c = connected;
+    trace_record(TRACE_CONNECTION, &c, 1);
+}
+
+static void trace_battery(BatteryChargeState batstate)
+{
+    trace_record(TRACE_BATTERY, &batstate, sizeof(batstate));
+}
+
+static void trace_message(DictionaryIterator *iter)
+{
+    trace_record(TRACE_MESSAGE, iter->dictionary, dict_size(iter));
 }
 
+static void trace_tap(AccelAxisType axis, int32_t direction)
+{
+    int8_t tap[2] = { axis, direction };
+    trace_record(TRACE_TAP, tap, sizeof(tap));
+}
+#else
+// only replayed inputs are handled
+#define TRACE_INPUT(record) if (! g.trace.replaying) return
+#endif
+#else
+#define TRACE_INPUT(record)
+#endif
+
 static void check_location_request(void)
 {
-    if (g.flip_colors_conf && g.ready)
-        send_request(REQUEST_LOCATION);
+    if (g.flip_colors_conf)
+        outbox_send(OUTBOX_LOCATION);
+}
+
+static void load_bmpset(struct bmpset *set, uint32_t resid, int size)
+{
+    set->bmp = gbitmap_create_with_resource(resid);
+    struct GRect bounds = gbitmap_get_bounds(set->bmp);
+    set->w = bounds.size.w;
+    set->h = bounds.size.h / size;
+}
+
+static uint32_t font_to_resource_id(uint8_t fontid)
+{
+    switch (fontid)
+    {
+    case BLOCKY_FONT: return RESOURCE_ID_BLOCKY13;
+    case BLOCKY_SMALL_FONT: return RESOURCE_ID_BLOCKY9;
+    case SMOOTH_FONT: return RESOURCE_ID_DIGITS15;
+    case SMOOTH_SMALL_FONT: return RESOURCE_ID_DIGITS13;
+    default: return 0;
+    }
+}
+
+// decodes font into set unless it is there already, NO_FONT only releases it
+static void use_font(struct bmpset *set, uint8_t *loaded, uint8_t font)
+{
+    if (*loaded == font) return;
+    if (set->bmp)
+    {
+        gbitmap_destroy(set->bmp);
+        set->bmp = NULL;
+    }
+    *loaded = font;
+    if (font == NO_FONT) return;
+
+#if STARTUP
+    uint32_t t = startup_ms();
+#endif
+    load_bmpset(set, font_to_resource_id(font), 10);
+#if STARTUP
+    if (! g.startup.done) g.startup.resources += startup_ms() - t;
+#endif
+}
+
+static void cleanup_fonts(void)
+{
+    if (g.day.sprite)
+    {
+        gbitmap_destroy(g.day.sprite);
+        g.day.sprite = NULL;
+    }
+    use_font(&g.day.font, &g.loaded_fonts.day, NO_FONT);
+    use_font(&g.dialfont, &g.loaded_fonts.dial, NO_FONT);
+}
+
+// only the fonts of shown features are kept, they are decoded on first use
+static void update_fonts(void)
+{
+    if (! g.day.show && g.day.sprite)
+    {
+        gbitmap_destroy(g.day.sprite);
+        g.day.sprite = NULL;
+    }
+    use_font(&g.day.font, &g.loaded_fonts.day,
+             g.day.show ? g.fontconf.day : NO_FONT);
+    use_font(&g.dialfont, &g.loaded_fonts.dial,
+             g.dialnumbers.show ? g.fontconf.dial : NO_FONT);
 }
 
 static void draw_week(GBitmap *bmp, int x, int y)
@@ -253,55 +1081,222 @@ static void draw_week(GBitmap *bmp, int x, int y)
     }
 }
 
-static void draw_day(GBitmap *bmp, int x, int y)
+// week boxes and digits with their top left corner at x, y
+static void draw_day_widget(GBitmap *bmp, int x, int y)
 {
-    int x0 = (x - g.day.font.w - 2);
-    int x1 = x0 + g.day.font.w + 4;
-    int my = 2;
+    int x1 = x + g.day.font.w + 4;
 
-    draw_week(bmp, x0, y + my);
+    draw_week(bmp, x, y + g.day.font.h + 4);
 
     int d10 = g.day.ofmonth / 10;
     int d01 = g.day.ofmonth - d10 * 10;
     uint32_t colors = get_colors(g.bgcol, g.daycolors.dayofmonth);
-    int y0 = y - g.day.font.h - my;
-    if (x0 & 0x3)
+    if (x & 0x3)
     {
-        draw_2bit_bmp(bmp, &g.day.font, d10, x0, y0, colors);
-        draw_2bit_bmp(bmp, &g.day.font, d01, x1, y0, colors);
+        draw_2bit_bmp(bmp, &g.day.font, d10, x, y, colors);
+        draw_2bit_bmp(bmp, &g.day.font, d01, x1, y, colors);
     }
     else
     {
-        draw_2bit_bmp_aligned(bmp, &g.day.font, d10, x0, y0, colors);
-        draw_2bit_bmp_aligned(bmp, &g.day.font, d01, x1, y0, colors);
+        draw_2bit_bmp_aligned(bmp, &g.day.font, d10, x, y, colors);
+        draw_2bit_bmp_aligned(bmp, &g.day.font, d01, x1, y, colors);
     }
 }
 
-struct rect { int x0, y0, x1, y1; };
-
-static struct rect get_day_rect(int px, int py)
+// the widget is kept with its background in a sprite, which is only redrawn
+// when the day, its colors or the font change
+static void draw_day(GBitmap *bmp, int x, int y)
 {
+    int x0 = (x - g.day.font.w - 2);
     int my = 2;
-    return (struct rect){
-        (px - g.day.font.w - 2) >> 2,
-        py - g.day.font.h - my,
-        (px + g.day.font.w + 4) >> 2,
-        py + 11 + my,
+    int y0 = y - g.day.font.h - my;
+    int x2 = x0 + 2 * g.day.font.w + 4;
+    if (x2 < x0 + 28) x2 = x0 + 28;
+    int y2 = y + my + 11;
+
+    // dither patterns of 1 bit rows depend on the parity of the position
+    bool bits = is_1bit(bmp);
+    int ox = bits ? x0 & 1 : 0;
+    int oy = bits ? y0 & 1 : 0;
+    struct day_key key = {
+        .colors = get_colors(g.bgcol, g.daycolors.dayofmonth),
+        .today = process_color(g.daycolors.today),
+        .sunday = process_color(g.daycolors.sunday),
+        .weekday = process_color(g.daycolors.weekday),
+        .ofweek = g.day.ofweek,
+        .ofmonth = g.day.ofmonth,
+        .font = g.fontconf.day,
+        .bits = bits,
+        .parity = ox | oy << 1,
     };
+    if (g.day.sprite && memcmp(&key, &g.day.key, sizeof(key)) != 0)
+    {
+        gbitmap_destroy(g.day.sprite);
+        g.day.sprite = NULL;
+    }
+    if (! g.day.sprite)
+    {
+        // rounded up to words for the aligned digits
+        int w = (ox + x2 - x0 + 3) & ~3;
+        int h = oy + y2 - y0;
+        g.day.sprite = gbitmap_create_blank(
+            GSize(w, h), bits ? GBitmapFormat1Bit : GBitmapFormat8Bit);
+        if (g.day.sprite)
+        {
+            // the primitives clip to the sprite, then to the layout again
+            GRect b = g.layout.bounds;
+            set_clip_rect(0, 0, w, h);
+            draw_box(g.day.sprite, key.colors & 0xFF, 0, 0, w, h);
+            draw_day_widget(g.day.sprite, ox, oy);
+            set_clip_rect(b.origin.x, b.origin.y, b.origin.x + b.size.w,
+                          b.origin.y + b.size.h);
+            g.day.key = key;
+        }
+    }
+
+    if (g.day.sprite)
+        draw_bitmap(bmp, g.day.sprite, x0 - ox, y0 - oy);
+    else
+        draw_day_widget(bmp, x0, y0);
+    update_scanlines(g.scanlines, y0, y2, x0, x2);
+}
+
+// appends runs of len pixels of color c at run + n, or only counts them if
+// run is NULL, returns the new number of bytes
+static int put_runs(uint8_t *run, int n, uint8_t c, int len)
+{
+    for (; len > 0; len -= 255, n += 2)
+    {
+        if (run)
+        {
+            run[n] = c;
+            run[n + 1] = len < 255 ? len : 255;
+        }
+    }
+    return n;
+}
+
+// writes the runs of the visible part of a row to run, or only counts them
+// if run is NULL, returns the number of bytes, everything outside of the
+// span is background
+static int encode_row(GBitmapDataRowInfo row, struct scanline span,
+                      uint8_t bg, uint8_t *run)
+{
+    int x0 = span.start * 4;
+    int x1 = span.end * 4;
+    if (x0 < row.min_x) x0 = row.min_x;
+    if (x1 > row.max_x + 1) x1 = row.max_x + 1;
+    if (x0 >= x1)
+        return put_runs(run, 0, bg, row.max_x - row.min_x + 1);
+
+    int n = put_runs(run, 0, bg, x0 - row.min_x);
+    uint8_t c = row.data[x0];
+    int len = 0;
+    for (int x = x0; x < x1; ++x)
+    {
+        if (row.data[x] != c || len == 255)
+        {
+            n = put_runs(run, n, c, len);
+            c = row.data[x];
+            len = 0;
+        }
+        ++len;
+    }
+    n = put_runs(run, n, c, len);
+    return put_runs(run, n, bg, row.max_x + 1 - x1);
 }
 
-static void clear_day(GBitmap *bmp, int px, int py)
+// run length encode the first h rows of bmp into the static layer, g.scanlines
+// must hold what was drawn on the background since it was cleared
+static void encode_static_layer(GBitmap *bmp, int h, uint8_t bg)
 {
-    struct rect r = get_day_rect(px, py);
-    uint32_t col = process_color(g.bgcol);
-    uint32_t col4 = (col << 24) | (col << 16) | (col << 8) | col;
+    // rows are re-indexed and the buffers may be gone if an allocation
+    // fails, the next frame then clears and draws everything again
+    g.statics.valid = false;
+    if (g.statics.num_rows < h)
+    {
+        free(g.statics.rows);
+        free(g.statics.spans);
+        g.statics.rows = malloc((h + 1) * sizeof(*g.statics.rows));
+        g.statics.spans = malloc(h * sizeof(*g.statics.spans));
+        g.statics.num_rows = h;
+        if (g.statics.rows == NULL || g.statics.spans == NULL)
+        {
+            APP_LOG(APP_LOG_LEVEL_ERROR, "failed to allocate static layer");
+            g.statics.num_rows = 0;
+            return;
+        }
+    }
+
+    // runs of 1 bit rows would hardly be shorter than the rows
+    g.statics.bits = is_1bit(bmp);
+    int stride = gbitmap_get_bytes_per_row(bmp);
+
+    int n = 0;
+    for (int y = 0; y < h; ++y)
+    {
+        g.statics.rows[y] = n;
+        g.statics.spans[y] = g.scanlines[y];
+        n += g.statics.bits ? stride :
+            encode_row(gbitmap_get_data_row_info(bmp, y), g.scanlines[y],
+                       bg, NULL);
+    }
+    g.statics.rows[h] = n;
+    g.statics.h = h;
 
-    for (int y = r.y0; y < r.y1; ++y)
+    if (g.statics.size < n)
+    {
+        free(g.statics.runs);
+        g.statics.runs = malloc(n);
+        g.statics.size = g.statics.runs ? n : 0;
+        if (g.statics.runs == NULL)
+        {
+            APP_LOG(APP_LOG_LEVEL_ERROR, "failed to allocate static layer");
+            return;
+        }
+        APP_LOG(APP_LOG_LEVEL_DEBUG,
+                "static layer: %d bytes, heap used %d, free %d",
+                (int)(n + (h + 1) * sizeof(*g.statics.rows) +
+                      h * sizeof(*g.statics.spans)),
+                (int)heap_bytes_used(), (int)heap_bytes_free());
+    }
+
+    for (int y = 0; y < h; ++y)
     {
         GBitmapDataRowInfo row = gbitmap_get_data_row_info(bmp, y);
-        uint32_t *line = (uint32_t *)row.data;
-        for (int x = r.x0; x < r.x1; ++x)
-            line[x] = col4;
+        if (g.statics.bits)
+            memcpy(g.statics.runs + g.statics.rows[y], row.data, stride);
+        else
+            encode_row(row, g.scanlines[y], bg,
+                       g.statics.runs + g.statics.rows[y]);
+    }
+
+    g.statics.valid = true;
+}
+
+// copy [x0, x1) of row y back from the static layer
+static void restore_static_span(GBitmapDataRowInfo row, int y, int x0, int x1)
+{
+    const uint8_t *run = g.statics.runs + g.statics.rows[y];
+    const uint8_t *end = g.statics.runs + g.statics.rows[y + 1];
+    int x = row.min_x;
+#if RASTER_STATS
+    count_cleared(y, x0, x1);
+#endif
+
+    if (g.statics.bits)
+    {
+        memcpy(row.data + (x0 >> 3), run + (x0 >> 3),
+               ((x1 + 7) >> 3) - (x0 >> 3));
+        return;
+    }
+
+    for (; run < end && x < x1; run += 2)
+    {
+        int rx0 = x > x0 ? x : x0;
+        x += run[1];
+        int rx1 = x < x1 ? x : x1;
+        if (rx0 < rx1) memset(row.data + rx0, run[0], rx1 - rx0);
     }
 }
 
@@ -320,19 +1315,6 @@ static inline bool show_status(void)
     return show_disconnected() || show_battery();
 }
 
-static inline void update_scanlines(struct scanline *scanlines,
-                                    int y0, int y1, int x0, int x1)
-{
-    int start = x0 >> 2;
-    int end = (x1 + 3) >> 2;
-    for (int y = y0; y < y1; ++y)
-    {
-        struct scanline *line = scanlines + y;
-        if (line->start > start) line->start = start;
-        if (line->end < end) line->end = end;
-    }
-}
-
 static void draw_dial_digits(GBitmap *bmp, int x, int y, int n, bool pad)
 {
     int y0 = (y - g.dialfont.h / 2);
@@ -371,132 +1353,117 @@ static inline int absi(int i)
     return i < 0 ? -i : i;
 }
 
-static void draw_circle_tick(GBitmap *bmp, struct tick_conf *conf,
-                             int32_t cx, int32_t cy, int a, int s)
+// distance from the center to the edge of a rounded rect with half size
+// (w2, h2) and corner radius r towards (sina, -cosa)
+static int32_t get_rect_edge(int32_t sina, int32_t cosa,
+                             int32_t w2, int32_t h2, int32_t r, uint8_t *kind)
 {
-    if (conf->h > 0 && conf->w > 0)
-    {
-        int32_t sina = sin_lookup(a);
-        int32_t cosa = cos_lookup(a);
-
-        int32_t px = cx + sina * s / TRIG_MAX_RATIO;
-        int32_t py = cy - cosa * s / TRIG_MAX_RATIO;
-        int32_t dx = -sina * fixed(256) / TRIG_MAX_RATIO;
-        int32_t dy = cosa * fixed(256) / TRIG_MAX_RATIO;
-
-        uint32_t colors = get_aa_colors(g.bgcol, conf->col);
+    int32_t ax = absi(sina);
+    int32_t ay = absi(cosa);
 
-        draw_bg_rect(bmp, g.scanlines, colors, px, py, dx, dy, conf->h,
-                     conf->w / 2);
+    if (ax * (h2 - r) > ay * w2)
+    {
+        *kind = TICK_HSTRIP;
+        return w2 * TRIG_MAX_RATIO / ax;
+    }
+    else if (ax * h2 < ay * (w2 - r))
+    {
+        *kind = TICK_VSTRIP;
+        return h2 * TRIG_MAX_RATIO / ay;
+    }
+    else
+    {
+        // |t * (ax, ay) - (ex, ey)| = r for the corner circle at (ex, ey)
+        int32_t ex = w2 - r;
+        int32_t ey = h2 - r;
+        int32_t ue = (ax * ex + ay * ey) / TRIG_MAX_RATIO;
+        *kind = TICK_RECT;
+        return ue + sqrti(ue * ue - ex * ex - ey * ey + r * r);
     }
 }
 
-/*
-static void draw_rect_tick(GBitmap *bmp, struct tick_conf *conf,
-                           int32_t cx, int32_t cy, int a,
-                           int32_t w2, int32_t h2, int32_t r)
+static void update_dial_layout(int w2, int h2)
 {
-    if (conf->h > 0 && conf->w > 0)
-    {
-        int32_t sina = sin_lookup(a);
-        int32_t cosa = cos_lookup(a);
+    struct dial_key key = {
+        .w2 = w2,
+        .h2 = h2,
+        .rounded_rect = g.rounded_rect,
+        .inset = fixed(g.dialfont.w + g.dialfont.h / 2) +
+                 (g.hour_tick.show ? g.hour_tick.h : 0),
+    };
 
-        int32_t ax = absi(sina);
-        int32_t ay = absi(cosa);
+    if (key.w2 == g.dial.key.w2 && key.h2 == g.dial.key.h2 &&
+        key.rounded_rect == g.dial.key.rounded_rect &&
+        key.inset == g.dial.key.inset)
+        return;
 
-        int32_t dx = -sina * fixed(256) / TRIG_MAX_RATIO;
-        int32_t dy = cosa * fixed(256) / TRIG_MAX_RATIO;
+    g.dial.key = key;
 
-        uint32_t colors = get_aa_colors(g.bgcol, conf->col);
+    int32_t s = fixed(15) / 16;
+    int r = w2 < h2 ? w2 : h2;
+    bool rounded = g.rounded_rect > 0 && g.rounded_rect < r;
+    int32_t cx = fixed(w2);
+    int32_t cy = fixed(h2);
+    int32_t half = 1 << (FIXED_SHIFT - 1);
 
-        if (ax * (h2 - r) > ay * w2)
-        {
-            int32_t w2h = w2 - conf->h;
-            int32_t px = cx + (dx < 0 ? w2h : -w2h);
-            int32_t py = cy - cosa * w2h / ax;
+    for (int i = 0; i < 60; ++i)
+    {
+        int32_t a = i * TRIG_MAX_ANGLE / 60;
+        int32_t sina = sin_lookup(a);
+        int32_t cosa = cos_lookup(a);
 
-            draw_hstrip(bmp, g.scanlines, colors, px, py, -dx, -dy,
-                        conf->h, conf->w / 2);
-        }
-        else if (ax * h2 < ay * (w2 - r))
-        {
-            int32_t h2h = h2 - conf->h;
-            int32_t px = cx + sina * h2h / ay;
-            int32_t py = cy + (dy < 0 ? h2h : -h2h);
+        struct tick_anchor *tick = g.dial.ticks + i;
+        tick->kind = TICK_RECT;
+        int32_t t = s * r;
+        if (rounded)
+            t = get_rect_edge(sina, cosa, s * w2, s * h2,
+                              fixed(g.rounded_rect), &tick->kind);
 
-            draw_vstrip(bmp, g.scanlines, colors, px, py, -dx, -dy,
-                        conf->h, conf->w / 2);
-        }
-        else
+        tick->px = cx + sina * t / TRIG_MAX_RATIO;
+        tick->py = cy - cosa * t / TRIG_MAX_RATIO;
+        tick->dx = -sina * fixed(256) / TRIG_MAX_RATIO;
+        tick->dy = cosa * fixed(256) / TRIG_MAX_RATIO;
+
+        if (i % 5 == 0)
         {
-            int32_t w2h = w2 - conf->h;
-            int32_t h2h = h2 - conf->h;
-
-            // normal of direction
-            // shorten normal to avoid overflow
-            int32_t nx = dy >> 1;
-            int32_t ny = -dx >> 1;
-            int32_t snx2 = (nx * nx);
-            int32_t ny2 = (ny * ny) >> FIXED_SHIFT;
-            // vector from corner circle center to watchface center
-            int32_t ex = (dx > 0 ? w2h - r : r - w2h);
-            int32_t ey = (dy > 0 ? h2h - r : r - h2h);
-            int32_t sen = (ex * nx + ey * ny);
-            int32_t en = sen >> FIXED_SHIFT;
-            int32_t r2 = (r * r) >> FIXED_SHIFT;
-
-            int32_t a = fixed(1) + snx2 / ny2;
-            int32_t b = -en * nx / ny2;
-            int32_t c = en * en / ny2 - r2;
-
-            int32_t sqrt = sqrti(b * b - a * c);
-
-            // (x,y) of intersection relative to corner circle center
-            int32_t x = (((dx < 0 ? sqrt : - sqrt) - b) << FIXED_SHIFT) / a;
-            int32_t y = (sen - x * nx) / ny;
-            int32_t px = cx - ex + x;
-            int32_t py = cy - ey + y;
-
-            draw_bg_rect(bmp, g.scanlines, colors, px, py, -dx, -dy,
-                         conf->h, conf->w / 2);
+            t -= key.inset;
+            g.dial.numbers[i / 5].x =
+                (cx + sina * t / TRIG_MAX_RATIO + half) >> FIXED_SHIFT;
+            g.dial.numbers[i / 5].y =
+                (cy - cosa * t / TRIG_MAX_RATIO + half) >> FIXED_SHIFT;
         }
     }
 }
-*/
 
-static void draw_tick(GBitmap *bmp, struct tick_conf *conf,
-                      int32_t cx, int32_t cy, int a,
-                      int w2, int h2, int32_t s)
+static void draw_tick(GBitmap *bmp, struct tick_conf *conf, int i)
 {
-    int r = w2 < h2 ? w2 : h2;
-
-    /*
-    if (g.rounded_rect > 0 && g.rounded_rect < r)
-    {
-        int32_t sw = s * w2;
-        int32_t sh = s * h2;
-        int32_t fr = fixed(g.rounded_rect);
-        draw_rect_tick(bmp, conf, cx, cy, a, sw, sh, fr);
-    }
-    else
-    */
+    if (conf->h > 0 && conf->w > 0)
     {
-        draw_circle_tick(bmp, conf, cx, cy, a, s * r);
+        struct tick_anchor *t = g.dial.ticks + i;
+        uint32_t colors = get_aa_colors(g.bgcol, conf->col);
+
+        switch (t->kind)
+        {
+        case TICK_HSTRIP:
+            draw_hstrip(bmp, g.scanlines, colors, t->px, t->py, t->dx, t->dy,
+                        conf->h, conf->w / 2);
+            break;
+        case TICK_VSTRIP:
+            draw_vstrip(bmp, g.scanlines, colors, t->px, t->py, t->dx, t->dy,
+                        conf->h, conf->w / 2);
+            break;
+        default:
+            draw_bg_rect(bmp, g.scanlines, colors, t->px, t->py, t->dx, t->dy,
+                         conf->h, conf->w / 2);
+            break;
+        }
     }
 }
 
-static void draw_dial_number(GBitmap *bmp, int n, bool pad,
-                             int cx, int cy, int a, int32_t r)
+static void draw_dial_number(GBitmap *bmp, int n, bool pad, int i)
 {
-    int32_t sina = sin_lookup(a);
-    int32_t cosa = cos_lookup(a);
-    int32_t w = g.dialfont.w;
-    int32_t h = g.dialfont.h;
-    int32_t t = r - fixed(w + h / 2);
-    int32_t half = 1 << (FIXED_SHIFT - 1);
-    int nx = (cx + sina * t / TRIG_MAX_RATIO + half) >> FIXED_SHIFT;
-    int ny = (cy - cosa * t / TRIG_MAX_RATIO + half) >> FIXED_SHIFT;
-    draw_dial_digits(bmp, nx, ny, n, pad);
+    draw_dial_digits(bmp, g.dial.numbers[i / 5].x, g.dial.numbers[i / 5].y,
+                     n, pad);
 }
 
 static void calc_suntimes(void)
@@ -529,8 +1496,8 @@ static void calc_suntimes(void)
     }
     else
     {
-        int d = atan2_lookup(sqrti((TRIG_MAX_RATIO - x) * 0x1000),
-                             sqrti((TRIG_MAX_RATIO + x) * 0x1000)) * 48;
+        int d = atan2i(sqrti((TRIG_MAX_RATIO - x) * 0x1000),
+                       sqrti((TRIG_MAX_RATIO + x) * 0x1000)) * 48;
         int a = (-11198 * sin_lookup(352 * g.day.ofyear + 5206) -
                    8513 * sin_lookup(186 * g.day.ofyear - 1565) + 32768) >> 16;
 
@@ -555,7 +1522,7 @@ static inline void set_color_flip(bool flip)
     if (g.flip_colors != flip)
     {
         g.flip_colors = flip;
-        clear_bg();
+        request_redraw(REDRAW_PALETTE);
     }
 }
 
@@ -571,11 +1538,59 @@ static inline void update_color_flip(void)
     }
 }
 
+static inline int suntime(int16_t t)
+{
+    switch (t)
+    {
+    case SUN_ALWAYS_UP: return 0;
+    case SUN_NEVER_UP: return 1440;
+    default: return t + g.gmtoff;
+    }
+}
+
+// FNV-1a of n bytes at p, continuing from h
+static uint32_t hash_bytes(uint32_t h, const void *p, size_t n)
+{
+    const uint8_t *b = p;
+    for (size_t i = 0; i < n; ++i)
+        h = (h ^ b[i]) * 16777619u;
+    return h;
+}
+
+// of everything the sun times of today depend on
+static uint32_t sun_hash(void)
+{
+    int16_t day[3] = { g.day.year, g.day.ofyear, g.gmtoff };
+    uint32_t h = hash_bytes(2166136261u, day, sizeof(day));
+    h = hash_bytes(h, &g.lon, sizeof(g.lon));
+    h = hash_bytes(h, &g.lat, sizeof(g.lat));
+    return hash_bytes(h, &g.suntimes, sizeof(g.suntimes));
+}
+
 static void update_day_night(void)
 {
     APP_LOG(APP_LOG_LEVEL_DEBUG, "day of year: %d", g.day.ofyear);
 
-    if (g.lon != INVALID_DEGREE && g.lat != INVALID_DEGREE)
+    uint32_t hash = sun_hash();
+    if (hash == g.warm.hash)
+    {
+        g.sunrise = g.warm.sunrise;
+        g.sunset = g.warm.sunset;
+#if STARTUP
+        if (! g.startup.done) g.startup.warm = true;
+#endif
+        update_color_flip();
+        return;
+    }
+
+    int left = suntimes_left();
+    if (left > 0)
+    {
+        int i = SUNTIMES_DAYS - left;
+        g.sunrise = suntime(g.suntimes.times[i][0]);
+        g.sunset = suntime(g.suntimes.times[i][1]);
+    }
+    else if (g.lon != INVALID_DEGREE && g.lat != INVALID_DEGREE)
     {
         calc_suntimes();
     }
@@ -586,19 +1601,28 @@ static void update_day_night(void)
         g.sunset = 18 * 60;
     }
 
+    g.warm.hash = hash;
+    g.warm.sunrise = g.sunrise;
+    g.warm.sunset = g.sunset;
+    g.warm_changed = true;
     update_color_flip();
 }
 
-static void update_time(struct tm *t)
+// returns the redraw reasons of the new time
+static uint8_t update_time(struct tm *t)
 {
+    uint8_t reasons = REDRAW_SECOND;
     bool check_location = false;
 
     if (g.hour != t->tm_hour)
     {
         g.hour = t->tm_hour;
         check_location = true;
+        reasons |= REDRAW_MINUTE;
     }
 
+    if (g.min != t->tm_min)
+        reasons |= REDRAW_MINUTE;
     g.min = t->tm_min;
     g.sec = t->tm_sec;
     int dmin = t->tm_hour * 60 + t->tm_min;
@@ -612,7 +1636,7 @@ static void update_time(struct tm *t)
     {
         g.day.ofweek = t->tm_wday;
         g.day.ofmonth = t->tm_mday;
-        g.day.update = true;
+        reasons |= REDRAW_DAY;
     }
 
     int off = t->tm_gmtoff / 60;
@@ -620,6 +1644,7 @@ static void update_time(struct tm *t)
     if (g.gmtoff != off || t->tm_yday != g.day.ofyear)
     {
         g.day.ofyear = t->tm_yday;
+        g.day.year = t->tm_year;
         g.gmtoff = off;
         update_day_night();
         check_location = true;
@@ -631,9 +1656,11 @@ static void update_time(struct tm *t)
 #if DEMO
     g.hour = g.min % 24;
     g.min = g.sec;
+    reasons |= REDRAW_MINUTE;
     // g.day.ofmonth = g.sec % 32;
-    // g.day.update = true;
+    // reasons |= REDRAW_DAY;
 #endif
+    return reasons;
 }
 
 static inline int sector(int dx, int dy)
@@ -653,35 +1680,85 @@ static inline int sector_y(int s)
     return dy[s & 0x3];
 }
 
-static void draw_status(GBitmap *bmp, int cx, int cy, int r,
-                        int *blocked, int first)
+static void place_status(struct static_key *key, int *blocked, int first)
 {
-
     int i;
     for (i = 0; i < 4; ++i)
         if (!blocked[(first + i) % 4])
             break;
     int s = (i + first) % 4;
 
-    int px = cx + sector_x(s) * r;
-    int py = cy + sector_y(s) * r;
-
     if (show_disconnected())
     {
-        draw_disconnected(bmp, g.scanlines,
-                          process_color(g.statusconf.color), px, py);
+        key->status[0] = s;
         blocked[s] = 2;
         for (i = 0; i < 4; ++i)
             if (blocked[(first + i) % 4] < 2)
                 break;
         s = (i + first) % 4;
-        px = cx + sector_x(s) * r;
-        py = cy + sector_y(s) * r;
     }
 
     if (show_battery())
-        draw_battery(bmp, g.scanlines, process_color(g.statusconf.color),
-                     px, py, g.status.batstate.charge_percent);
+    {
+        key->status[1] = s;
+        key->battery = g.status.batstate.charge_percent;
+    }
+}
+
+static void draw_status(GBitmap *bmp, const struct static_key *key,
+                        int cx, int cy, int r)
+{
+    uint8_t color = process_color(g.statusconf.color);
+    int s = key->status[0];
+    if (s >= 0)
+        draw_disconnected(bmp, g.scanlines, color,
+                          cx + sector_x(s) * r, cy + sector_y(s) * r);
+
+    s = key->status[1];
+    if (s >= 0)
+        draw_battery(bmp, g.scanlines, color,
+                     cx + sector_x(s) * r, cy + sector_y(s) * r, key->battery);
+}
+
+// outline of a hand of length len and half width w, starting at (px, py)
+static int get_hand_shape(struct point *pts, uint8_t shape,
+                          int32_t px, int32_t py, int32_t dx, int32_t dy,
+                          int32_t len, int32_t w)
+{
+    // (s, t) along and across the hand
+    int32_t st[5][2];
+    int n = 0;
+    int32_t head = w * 2 < len ? w * 2 : len;
+
+    switch (shape)
+    {
+    case HAND_TAPERED:
+        st[n][0] = 0;   st[n++][1] = w;
+        st[n][0] = len; st[n++][1] = w / 3;
+        st[n][0] = len; st[n++][1] = -w / 3;
+        st[n][0] = 0;   st[n++][1] = -w;
+        break;
+    case HAND_ARROW:
+        st[n][0] = 0;          st[n++][1] = w;
+        st[n][0] = len - head; st[n++][1] = w;
+        st[n][0] = len;        st[n++][1] = 0;
+        st[n][0] = len - head; st[n++][1] = -w;
+        st[n][0] = 0;          st[n++][1] = -w;
+        break;
+    case HAND_LOZENGE:
+        st[n][0] = 0;       st[n++][1] = 0;
+        st[n][0] = len / 4; st[n++][1] = w;
+        st[n][0] = len;     st[n++][1] = 0;
+        st[n][0] = len / 4; st[n++][1] = -w;
+        break;
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        pts[i].x = px + ((dx * st[i][0] - dy * st[i][1]) >> (FIXED_SHIFT + 8));
+        pts[i].y = py + ((dy * st[i][0] + dx * st[i][1]) >> (FIXED_SHIFT + 8));
+    }
+    return n;
 }
 
 static void draw_hand(struct GBitmap *bmp,struct hand_conf *conf, int32_t mr,
@@ -690,7 +1767,20 @@ static void draw_hand(struct GBitmap *bmp,struct hand_conf *conf, int32_t mr,
     int32_t px = cx - dx * mr * conf->r0 / (fixed(256) * 256);
     int32_t py = cy - dy * mr * conf->r0 / (fixed(256) * 256);
     int32_t len = mr * (conf->r1 + conf->r0) / 256;
-    if (bg)
+
+    struct point pts[5];
+    int n = get_hand_shape(pts, conf->shape, px, py, dx, dy, len,
+                           conf->w / 2);
+    if (n > 0)
+    {
+        if (bg)
+            draw_bg_polygon(bmp, g.scanlines,
+                            get_aa_colors(g.bgcol, conf->col), pts, n);
+        else
+            draw_polygon(bmp, g.scanlines, process_color(conf->col), pts, n,
+                         g.outline, dark_color(process_color(g.bgcol)));
+    }
+    else if (bg)
     {
         uint32_t colors = get_aa_colors(g.bgcol, conf->col);
         draw_bg_rect(bmp, g.scanlines, colors, px, py, dx, dy, len,
@@ -704,92 +1794,265 @@ static void draw_hand(struct GBitmap *bmp,struct hand_conf *conf, int32_t mr,
 
 static bool show_seconds(void)
 {
-    return g.showsec < 0 || (g.showsec > 0 && g.seccount > 0);
+    return ! g.refresh.resting &&
+        (g.showsec < 0 || (g.showsec > 0 && g.seccount > 0));
 }
 
-static void render(GContext *ctx, GRect bounds)
+static bool sweeping(void)
 {
-    GBitmap *bmp = graphics_capture_frame_buffer(ctx);
-    if (bmp == NULL)
+    return show_seconds() && g.sweep.rate > 0 &&
+        (g.status.batstate.is_charging ||
+         g.status.batstate.charge_percent >= SWEEP_MIN_BATTERY);
+}
+
+// AA of ticks and numbers is only turned off by AA_NEVER, they are not
+// redrawn every frame
+static bool antialias_hands(void)
+{
+    switch (g.aa.mode)
     {
-        APP_LOG(APP_LOG_LEVEL_ERROR, "failed to capture framebuffer");
-        return;
+    case AA_ALWAYS: return true;
+    case AA_NEVER: return false;
+    default:
+        return ! g.sweep.timer && ! g.aa.overrun &&
+            (g.status.batstate.is_charging ||
+             g.status.batstate.charge_percent >= AA_MIN_BATTERY);
     }
+}
+
+static void get_static_key(struct static_key *key, int w2, int h2,
+                           int32_t hdx, int32_t hdy, int32_t mdx, int32_t mdy)
+{
+    memset(key, 0, sizeof(*key));
+    key->w2 = w2;
+    key->h2 = h2;
+    key->status[0] = -1;
+    key->status[1] = -1;
 
-    // get date and time if unset
-    if (g.day.ofmonth == 0)
+    // day
+    if (g.day.show || show_status())
     {
-        time_t t = time(NULL);
-        update_time(localtime(&t));
-    }
+        int r = g.layout.slot_r;
 
-    GRect bmpbounds = gbitmap_get_bounds(bmp);
-    grect_clip(&bounds, &bmpbounds);
+        int tdx = hdx;
+        int tdy = hdy;
+        int udx = mdx;
+        int udy = mdy;
 
-    int16_t w2 = bounds.size.w / 2;
-    int16_t h2 = bounds.size.h / 2;
-    // max radius
-    int32_t mr = fixed(w2 < h2 ? w2 : h2);
+        if (g.last_tick & 0x1)
+        {
+            int32_t a = ((g.hour % 12) * TRIG_MAX_ANGLE) / 12;
+            int32_t sina = sin_lookup(a);
+            int32_t cosa = cos_lookup(a);
+            tdx = sina * fixed(256) / TRIG_MAX_RATIO;
+            tdy = -cosa * fixed(256) / TRIG_MAX_RATIO;
+        }
 
-    uint8_t bg = process_color(g.bgcol);
+        if (g.last_tick & 0x2)
+        {
+            int32_t a = ((g.min / 5) * TRIG_MAX_ANGLE) / 12;
+            int32_t sina = sin_lookup(a);
+            int32_t cosa = cos_lookup(a);
+            udx = sina * fixed(256) / TRIG_MAX_RATIO;
+            udy = -cosa * fixed(256) / TRIG_MAX_RATIO;
+        }
 
-    // first clear
-    if (g.scanlines == NULL || g.num_scanlines < bounds.size.h)
-    {
-        free(g.scanlines);
+        int dx = -(tdx + udx) / 2;
+        int dy = -(tdy + udy) / 2;
+        if (dx == 0 && dy == 0)
+        {
+            dx = tdy;
+            dy = -tdx;
+        }
 
-        g.num_scanlines = bounds.size.h;
-        g.scanlines = calloc(g.num_scanlines, sizeof(*g.scanlines));
+        if (absi(dx) > absi(dy))
+        {
+            dx = dx > 0 ? r : -r;
+            dy = 0;
+        }
+        else
+        {
+            dx = 0;
+            dy = dy > 0 ? r : -r;
+        }
 
-        // clear background
-        for (int y = 0; y < bounds.size.h; ++y)
+        if (g.day.show)
         {
-            GBitmapDataRowInfo row = gbitmap_get_data_row_info(bmp, y);
-            memset(row.data + row.min_x, bg, row.max_x - row.min_x + 1);
-            struct scanline *sl = g.scanlines + y;
-            sl->start = bounds.size.w;
-            sl->end = 0;
+            key->day_px = w2 + dx;
+            key->day_py = h2 + dy;
         }
 
-        g.day.update = true;
+        // find places for status icons
+        if (show_status())
+        {
+            int blocked[4] = { 0 };
+            if (g.day.show) blocked[sector(dx, dy)] = 2;
+            blocked[sector(hdx, hdy)] = 1;
+            blocked[sector(mdx, mdy)] = 1;
+            int first = sector(-dx, -dy);
+
+            place_status(key, blocked, first);
+        }
     }
-    else
+
+    // dial marker, ticks are numbered 0 to 59
+    int round60 = (g.last_tick & 0x1) == 0 ? 30 : 0;
+    int round5 = (g.last_tick & 0x2) == 0 ? 2 : 0;
+    int hourmark = ((g.hour * 60 + g.min + round60) % 720) * 12 / 720;
+    int b = g.hour_tick.show ? hourmark * 5 : -1;
+
+    int minmark = (g.min + round5) / 5;
+    int a = (minmark * 5) % 60;
+    if (b == a) b = -1;
+
+    key->hour_tick = g.hour_tick.show ? a : -1;
+    key->hour_mark = b;
+
+    key->min_first = 0;
+    key->min_last = -1;
+    if (g.min_tick.show)
+    {
+        int mm = minmark * 5;
+        key->min_first = g.min < mm ? g.min : mm + 1;
+        key->min_last = g.min < mm ? mm - 1 : g.min;
+    }
+
+    key->hour_number = -1;
+    key->hour_number_pos = -1;
+    key->min_number = -1;
+    if (g.dialnumbers.show)
     {
-        // check if we need to redraw day due to cleared scanlines
-        if (! g.day.update)
+        int b = -1;
+        int h = -1;
+
+        if (g.dialnumbers.show & 0x1)
         {
-            struct rect r = get_day_rect(g.day.px, g.day.py);
-            for (int y = r.y0; y < r.y1; ++y)
-            {
-                struct scanline *sl = g.scanlines + y;
-                if (sl->start < r.x1 && sl->end > r.x0)
-                {
-                    g.day.update = true;
-                    break;
-                }
-            }
+            int f = clock_is_24h_style() ? 24 : 12;
+            h = ((g.hour * 60 + g.min + round60) / 60) % f;
+            if (h == 0) h = f;
+            b = (h % 12) * 5;
         }
 
-        // clear scanlines
-        uint32_t col4 = (bg << 24) | (bg << 16) | (bg << 8) | bg;
-        for (int y = 0; y < g.num_scanlines; ++y)
+        if (g.dialnumbers.show & 0x2)
         {
-            struct scanline *sl = g.scanlines + y;
-            GBitmapDataRowInfo row = gbitmap_get_data_row_info(bmp, y);
-            uint32_t *line = (uint32_t *)row.data;
-            for (int x = sl->start; x < sl->end; ++x)
-                line[x] = col4;
-            sl->start = bounds.size.w;
-            sl->end = 0;
+            int m = (((g.min + round5) / 5) * 5) % 60;
+            key->min_number = m;
+            if (b == m) b = -1;
+        }
+
+        if (b >= 0)
+        {
+            key->hour_number = h;
+            key->hour_number_pos = b;
         }
     }
-    int fr = g.center[0].r > g.center[1].r ? g.center[0].r : g.center[1].r;
-    int r = (fr + 0xf) >> FIXED_SHIFT;
-    for (int y = h2 - r - 1; y < h2 + r + 1; ++y)
+}
+
+// the tick of the second marker or -1, if a tick of the static layer is there
+static int get_sec_mark(void)
+{
+    if (! show_seconds())
+        return -1;
+
+    int round60 = (g.last_tick & 0x1) == 0 ? 30 : 0;
+    int round5 = (g.last_tick & 0x2) == 0 ? 2 : 0;
+    int hourmark = ((g.hour * 60 + g.min + round60) % 720) * 12 / 720;
+    int c = ((g.sec + 2) % 60) * 12 / 60 * 5;
+    if (g.hour_tick.show && c == hourmark * 5)
+        return -1;
+    if (c == (((g.min + round5) / 5) * 5) % 60)
+        return -1;
+    return c;
+}
+
+static void draw_statics(GBitmap *bmp, const struct static_key *key)
+{
+    update_fonts();
+    if (key->day_px || key->day_py)
+        draw_day(bmp, key->day_px, key->day_py);
+    PROFILE_STAGE(STAGE_DAY);
+
+    draw_status(bmp, key, key->w2, key->h2, g.layout.slot_r);
+    PROFILE_STAGE(STAGE_STATUS);
+
+    update_dial_layout(key->w2, key->h2);
+
+    if (key->hour_tick >= 0)
+        draw_tick(bmp, &g.hour_tick, key->hour_tick);
+
+    for (int i = key->min_first; i <= key->min_last; ++i)
+        draw_tick(bmp, &g.min_tick, i % 60);
+
+    if (key->hour_mark >= 0)
+        draw_tick(bmp, &g.hour_tick, key->hour_mark);
+    PROFILE_STAGE(STAGE_TICKS);
+
+    if (key->min_number >= 0)
+        draw_dial_number(bmp, key->min_number, true, key->min_number);
+
+    if (key->hour_number >= 0)
+        draw_dial_number(bmp, key->hour_number, false, key->hour_number_pos);
+    PROFILE_STAGE(STAGE_NUMBERS);
+}
+
+#if RASTER_STATS && ! BENCH
+// one JSON object per primitive type, so frames can be diffed line by line
+static void log_raster_stats(void)
+{
+    static const char *names[NUM_PRIMS] = {
+        "rect", "polygon", "strip", "circle", "bitmap", "clear"
+    };
+    const struct raster_stats *stats = get_raster_stats();
+    for (int i = 0; i < NUM_PRIMS; ++i)
     {
-        struct scanline *sl = g.scanlines + y;
-        sl->start = (w2 - r - 1) >> 2;
-        sl->end = (w2 + r + 1 + 3) >> 2;
+        APP_LOG(APP_LOG_LEVEL_DEBUG, "{\"prim\": \"%s\", \"calls\": %d, "
+                "\"rows\": %d, \"solid\": %d, \"blended\": %d, "
+                "\"cleared\": %d}", names[i], (int)stats[i].calls,
+                (int)stats[i].rows, (int)stats[i].solid,
+                (int)stats[i].blended, (int)stats[i].cleared);
+    }
+}
+#endif
+
+static void update_layout(GRect bounds)
+{
+    g.layout.bounds = bounds;
+    g.layout.w2 = bounds.size.w / 2;
+    g.layout.h2 = bounds.size.h / 2;
+    int r = g.layout.w2 < g.layout.h2 ? g.layout.w2 : g.layout.h2;
+    g.layout.mr = fixed(r);
+    g.layout.slot_r = r * 9 / 16;
+}
+
+// the primitives pick their kernels by the format of bmp, 8 bit on color
+// platforms and 1 bit on black and white ones
+static void draw_frame(GBitmap *bmp, GRect bounds, uint8_t reasons)
+{
+    GRect bmpbounds = gbitmap_get_bounds(bmp);
+    grect_clip(&bounds, &bmpbounds);
+    if (! grect_equal(&bounds, &g.layout.bounds))
+    {
+        update_layout(bounds);
+        reasons |= REDRAW_LAYOUT;
+    }
+    set_clip_rect(bounds.origin.x, bounds.origin.y,
+                  bounds.origin.x + bounds.size.w,
+                  bounds.origin.y + bounds.size.h);
+
+    int16_t w2 = g.layout.w2;
+    int16_t h2 = g.layout.h2;
+    int32_t mr = g.layout.mr;
+
+    uint8_t bg = process_color(g.bgcol);
+
+    // for the whole framebuffer, so an unobstructed area change keeps them
+    if (g.scanlines == NULL || g.num_scanlines < bmpbounds.size.h)
+    {
+        free(g.scanlines);
+
+        g.num_scanlines = bmpbounds.size.h;
+        g.scanlines = calloc(g.num_scanlines, sizeof(*g.scanlines));
+        g.statics.valid = false;
     }
 
     int32_t cx = fixed(w2);
@@ -821,275 +2084,518 @@ static void render(GContext *ctx, GRect bounds)
     // second
     if (show_seconds())
     {
-        int32_t a = (g.sec * TRIG_MAX_ANGLE) / 60;
+        int32_t a = ((g.sec * 1000 + g.ms) * (TRIG_MAX_ANGLE / 8)) / 7500;
         int32_t sina = sin_lookup(a);
         int32_t cosa = cos_lookup(a);
         sec.dx = sina * fixed(256) / TRIG_MAX_RATIO;
         sec.dy = -cosa * fixed(256) / TRIG_MAX_RATIO;
     }
 
-    // day
-    if (g.day.show || show_status())
-    {
-        int r = (mr >> FIXED_SHIFT) * 9 / 16;
-
-        int hdx = hour.dx;
-        int hdy = hour.dy;
-        int mdx = min.dx;
-        int mdy = min.dy;
+    // a new background needs everything cleared, not just the spans drawn
+    if (reasons & REDRAW_PALETTE)
+        g.statics.valid = false;
 
-        if (g.last_tick & 0x1)
-        {
-            int32_t a = ((g.hour % 12) * TRIG_MAX_ANGLE) / 12;
-            int32_t sina = sin_lookup(a);
-            int32_t cosa = cos_lookup(a);
-            hdx = sina * fixed(256) / TRIG_MAX_RATIO;
-            hdy = -cosa * fixed(256) / TRIG_MAX_RATIO;
-        }
-
-        if (g.last_tick & 0x2)
-        {
-            int32_t a = ((g.min / 5) * TRIG_MAX_ANGLE) / 12;
-            int32_t sina = sin_lookup(a);
-            int32_t cosa = cos_lookup(a);
-            mdx = sina * fixed(256) / TRIG_MAX_RATIO;
-            mdy = -cosa * fixed(256) / TRIG_MAX_RATIO;
-        }
+    // the key is only checked if it may have changed, moving hands just
+    // restore the static layer below them
+    struct static_key key;
+    bool statics = ! g.statics.valid || g.statics.h != bounds.size.h ||
+        (reasons & REDRAW_STATICS);
+    if (statics || (reasons & REDRAW_KEY))
+    {
+        get_static_key(&key, w2, h2, hour.dx, hour.dy, min.dx, min.dy);
+        statics = statics || memcmp(&key, &g.statics.key, sizeof(key)) != 0;
+    }
+    int sec_mark = get_sec_mark();
+    PROFILE_STAGE(STAGE_SETUP);
 
-        int dx = -(hdx + mdx) / 2;
-        int dy = -(hdy + mdy) / 2;
-        if (dx == 0 && dy == 0)
+    if (statics)
+    {
+        // clear what the last frame and the old static layer drew, rows
+        // which were outside of the unobstructed area are cleared entirely,
+        // as is everything if there is no valid static layer
+        for (int y = 0; y < bounds.size.h; ++y)
         {
-            dx = hdy;
-            dy = -hdx;
+            GBitmapDataRowInfo row = gbitmap_get_data_row_info(bmp, y);
+            struct scanline *sl = g.scanlines + y;
+            int x0 = row.min_x;
+            int x1 = row.max_x + 1;
+            if (g.statics.valid && y < g.statics.h)
+            {
+                struct scanline *span = g.statics.spans + y;
+                int start = sl->start < span->start ? sl->start : span->start;
+                int end = sl->end > span->end ? sl->end : span->end;
+                if (x0 < start * 4) x0 = start * 4;
+                if (x1 > end * 4) x1 = end * 4;
+            }
+            draw_span(bmp, bg, y, x0, x1);
+#if RASTER_STATS
+            count_cleared(y, x0, x1);
+#endif
         }
 
-        if (absi(dx) > absi(dy))
-        {
-            dx = dx > 0 ? r : -r;
-            dy = 0;
-        }
-        else
+        for (int y = 0; y < g.num_scanlines; ++y)
         {
-            dx = 0;
-            dy = dy > 0 ? r : -r;
+            struct scanline *sl = g.scanlines + y;
+            sl->start = bounds.size.w;
+            sl->end = 0;
         }
 
-        int px = w2 + dx;
-        int py = h2 + dy;
-
-        if (g.day.show)
-        {
-            if (g.day.px != px || g.day.py != py)
-            {
-                if (g.day.px || g.day.py)
-                    clear_day(bmp, g.day.px, g.day.py);
-                draw_day(bmp, px, py);
-                g.day.px = px;
-                g.day.py = py;
-            }
-            else if (g.day.update)
-                draw_day(bmp, g.day.px, g.day.py);
-        }
+        PROFILE_STAGE(STAGE_CLEAR);
+        set_antialias(g.aa.mode != AA_NEVER);
+        draw_statics(bmp, &key);
+        encode_static_layer(bmp, bounds.size.h, bg);
+        PROFILE_STAGE(STAGE_ENCODE);
+        g.statics.key = key;
 
-        // find places for status icons
-        if (show_status())
+        for (int y = 0; y < g.num_scanlines; ++y)
         {
-            int blocked[4] = { 0 };
-            if (g.day.show) blocked[sector(dx, dy)] = 2;
-            blocked[sector(hour.dx, hour.dy)] = 1;
-            blocked[sector(min.dx, min.dy)] = 1;
-            int first = sector(-dx, -dy);
-
-            draw_status(bmp, w2, h2, r, blocked, first);
+            struct scanline *sl = g.scanlines + y;
+            sl->start = bounds.size.w;
+            sl->end = 0;
         }
     }
-
-    if (! g.day.show && g.day.update && (g.day.px || g.day.py))
-    {
-        clear_day(bmp, g.day.px, g.day.py);
-    }
-
-    g.day.update = false;
-
-
-    // dial marker
+    else
     {
-        int32_t s = fixed(15) / 16;
-
-        int round60 = (g.last_tick & 0x1) == 0 ? 30 : 0;
-        int round5 = (g.last_tick & 0x2) == 0 ? 2 : 0;
-        int hourmark = ((g.hour * 60 + g.min + round60) % 720) * 12 / 720;
-        int32_t c = show_seconds()
-                        ? ((g.sec + 2) % 60) * 12 / 60 * TRIG_MAX_ANGLE / 12
-                        : -1;
-        int32_t b = g.hour_tick.show ? hourmark * TRIG_MAX_ANGLE / 12 : -1;
-        if (c == b) c = -1;
-
+        // restore what the last frame drew over, limited to the visible part
+        // of each row
+        for (int y = 0; y < bounds.size.h; ++y)
         {
-            int minmark = (g.min + round5) / 5;
-            int a = (minmark * TRIG_MAX_ANGLE / 12) % TRIG_MAX_ANGLE;
-            if (b == a || b == a) b = -1;
-            if (c == a || c == a) c = -1;
-
-            if (g.hour_tick.show)
-                draw_tick(bmp, &g.hour_tick, cx, cy, a, w2, h2, s);
-
-            if (g.min_tick.show)
+            struct scanline *sl = g.scanlines + y;
+            if (sl->start < sl->end)
             {
-                int mm = minmark * 5;
-                int m1 = g.min < mm ? g.min : mm + 1;
-                int m2 = g.min < mm ? mm - 1 : g.min;
-
-                for (int i = m1; i <= m2; ++i)
-                {
-                    int32_t a = (i * TRIG_MAX_ANGLE / 60) % TRIG_MAX_ANGLE;
-                    draw_tick(bmp, &g.min_tick, cx, cy, a, w2, h2, s);
-                }
+                GBitmapDataRowInfo row = gbitmap_get_data_row_info(bmp, y);
+                int x0 = sl->start * 4;
+                int x1 = sl->end * 4;
+                if (x0 < row.min_x) x0 = row.min_x;
+                if (x1 > row.max_x + 1) x1 = row.max_x + 1;
+                if (x0 < x1) restore_static_span(row, y, x0, x1);
             }
+            sl->start = bounds.size.w;
+            sl->end = 0;
         }
+        PROFILE_STAGE(STAGE_CLEAR);
+    }
 
-        if (b >= 0)
-            draw_tick(bmp, &g.hour_tick, cx, cy, b, w2, h2, s);
-        if (c >= 0)
-        {
-            // workaround for missing sec_tick config
-            struct tick_conf sec_tick = g.hour_tick;
-            sec_tick.col = process_color(g.sec_hand.col);
-            draw_tick(bmp, &sec_tick, cx, cy, c, w2, h2, s);
-        }
-
-        if (g.dialnumbers.show)
-        {
-            int b = -1;
-            int h = -1;
-
-            if (g.dialnumbers.show & 0x1)
-            {
-                int f = clock_is_24h_style() ? 24 : 12;
-                h = ((g.hour * 60 + g.min + round60) / 60) % f;
-                if (h == 0) h = f;
-                b = (h % 12) * TRIG_MAX_ANGLE / 12;
-            }
-
-            int32_t sr = (s * mr) >> FIXED_SHIFT;
-            int32_t sn = g.hour_tick.show ? sr - g.hour_tick.h : sr;
-
-            if (g.dialnumbers.show & 0x2)
-            {
-                int m = (((g.min + round5) / 5) * 5) % 60;
-                int a = m * TRIG_MAX_ANGLE / 60;
-                draw_dial_number(bmp, m, true, cx, cy, a, sn);
-                if (b == a) b = -1;
-            }
+    int fr = g.center[0].r > g.center[1].r ? g.center[0].r : g.center[1].r;
+    int r = (fr + 0xf) >> FIXED_SHIFT;
+    for (int y = h2 - r - 1; y < h2 + r + 1; ++y)
+    {
+        struct scanline *sl = g.scanlines + y;
+        sl->start = (w2 - r - 1) >> 2;
+        sl->end = (w2 + r + 1 + 3) >> 2;
+    }
 
-            if (b >= 0)
-                draw_dial_number(bmp, h, false, cx, cy, b, sn);
-        }
+    set_antialias(antialias_hands());
 
+    if (sec_mark >= 0)
+    {
+        // workaround for missing sec_tick config
+        struct tick_conf sec_tick = g.hour_tick;
+        sec_tick.col = process_color(g.sec_hand.col);
+        draw_tick(bmp, &sec_tick, sec_mark);
     }
+    PROFILE_STAGE(STAGE_TICKS);
 
     if (g.hourhand_below)
     {
         draw_hand(bmp, &g.hour_hand, mr, cx, cy, hour.dx, hour.dy, true);
+        PROFILE_STAGE(STAGE_HOUR);
         draw_hand(bmp, &g.min_hand, mr, cx, cy, min.dx, min.dy, false);
+        PROFILE_STAGE(STAGE_MIN);
     }
     else
     {
         draw_hand(bmp, &g.min_hand, mr, cx, cy, min.dx, min.dy, true);
+        PROFILE_STAGE(STAGE_MIN);
         draw_hand(bmp, &g.hour_hand, mr, cx, cy, hour.dx, hour.dy, false);
+        PROFILE_STAGE(STAGE_HOUR);
     }
 
     draw_circle(bmp, process_color(g.center[0].col), cx, cy, g.center[0].r,
                 g.outline, dark_color(bg));
+    PROFILE_STAGE(STAGE_CAPS);
 
     if (show_seconds())
     {
         draw_hand(bmp, &g.sec_hand, mr, cx, cy, sec.dx, sec.dy, false);
+        PROFILE_STAGE(STAGE_SEC);
         draw_circle(bmp, process_color(g.center[1].col), cx, cy, g.center[1].r,
                     g.outline, dark_color(bg));
+        PROFILE_STAGE(STAGE_CAPS);
+    }
+}
+
+static void render(GContext *ctx, GRect bounds, uint8_t reasons)
+{
+    PROFILE_START();
+#if RASTER_STATS
+    reset_raster_stats();
+#endif
+    GBitmap *bmp = graphics_capture_frame_buffer(ctx);
+    if (bmp == NULL)
+    {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "failed to capture framebuffer");
+        return;
     }
 
+    draw_frame(bmp, bounds, reasons);
 
     graphics_release_frame_buffer(ctx, bmp);
+    PROFILE_FRAME();
+    STARTUP_MARK(STARTUP_FRAME);
+#if RASTER_STATS && ! BENCH
+    log_raster_stats();
+#endif
 }
 
-static void redraw(struct Layer *layer, GContext *ctx)
+// lower the frame rate of the sweep, or fall back to ticking, after frames
+// took longer than their budget, and raise it again towards the configured
+// one after frames were short enough for a higher rate
+static void govern_sweep(int dt)
 {
-    // APP_LOG(APP_LOG_LEVEL_DEBUG, "redraw");
-    GRect bounds = layer_get_unobstructed_bounds(layer);
+    if (dt * g.sweep.rate * SWEEP_BUDGET > 1000)
+    {
+        g.sweep.under = 0;
+        if (++g.sweep.over < SWEEP_OVER_FRAMES)
+            return;
+        g.sweep.over = 0;
+        g.sweep.rate = g.sweep.rate > SWEEP_MIN_FPS + 2 ? g.sweep.rate - 2 :
+            g.sweep.rate > SWEEP_MIN_FPS ? SWEEP_MIN_FPS : 0;
+    }
+    else
+    {
+        g.sweep.over = 0;
+        int rate = g.sweep.rate + 2 < g.sweep.fps ? g.sweep.rate + 2 :
+            g.sweep.fps;
+        if (! g.sweep.rate || rate == g.sweep.rate)
+            return;
+        if (dt * rate * SWEEP_BUDGET > 1000)
+        {
+            g.sweep.under = 0;
+            return;
+        }
+        if (++g.sweep.under < SWEEP_UNDER_FRAMES)
+            return;
+        g.sweep.under = 0;
+        g.sweep.rate = rate;
+    }
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "sweep: %d fps, render %d ms",
+            g.sweep.rate, dt);
+}
+
 #if BENCH
-    uint16_t start = time_ms(NULL, NULL);
-    for (int i = 0; i < 12; ++i)
+// toggles a setting, a second call with restore set restores it
+static void bench_toggle(int preset, bool restore)
+{
+    switch (preset)
+    {
+    case BENCH_SECONDS:
+        if (restore)
+            g.showsec = g.bench.showsec;
+        else
+        {
+            g.bench.showsec = g.showsec;
+            g.showsec = show_seconds() ? 0 : -1;
+        }
+        break;
+    case BENCH_OUTLINE: g.outline = ! g.outline; break;
+    case BENCH_HOUR_BELOW: g.hourhand_below = ! g.hourhand_below; break;
+    case BENCH_COLOR_FLIP: g.flip_colors = ! g.flip_colors; break;
+    case BENCH_FONTS:
+        g.fontconf.day ^= SMOOTH_FONT;
+        g.fontconf.dial ^= SMOOTH_FONT;
+        break;
+    case BENCH_DIAL_NUMBERS: g.dialnumbers.show ^= 0x3; break;
+    case BENCH_STATUS:
+        // shows the battery at any charge
+        g.status.connected = ! g.status.connected;
+        if (restore)
+            g.statusconf.warnlevel = g.bench.warnlevel;
+        else
+        {
+            g.bench.warnlevel = g.statusconf.warnlevel;
+            g.statusconf.warnlevel = 100;
+        }
+        break;
+#if RASTER_8BIT && RASTER_1BIT
+    case BENCH_1BIT:
+        if (g.bench.bitmap)
+        {
+            gbitmap_destroy(g.bench.bitmap);
+            g.bench.bitmap = NULL;
+        }
+        else
+            g.bench.bitmap = gbitmap_create_blank(
+                layer_get_bounds(window_get_root_layer(g.window)).size,
+                GBitmapFormat1Bit);
+        break;
+#endif
+    }
+    g.statics.valid = false;
+}
+
+static int bench_percentile(int p)
+{
+    int n = 0;
+    for (int i = 0; i < 64; ++i)
+    {
+        n += g.bench.hist[i];
+        if (n * 100 >= BENCH_FRAMES * p)
+            return i;
+    }
+    return 63;
+}
+
+// reports a preset, with the resolution of time_ms()
+static void bench_report(void)
+{
+    static const char *names[NUM_BENCH_PRESETS] = {
+        "config", "seconds", "outline", "hourbelowmin", "colorflip",
+        "fonts", "dialnumbers", "status",
+#if RASTER_8BIT && RASTER_1BIT
+        "1bit",
+#endif
+    };
+    APP_LOG(APP_LOG_LEVEL_INFO, "bench %s: %d fps, p50 %d ms, p99 %d ms, "
+            "%d pixels per frame", names[g.bench.preset],
+            (int)(BENCH_FRAMES * 1000 / (g.bench.ms ? g.bench.ms : 1)),
+            bench_percentile(50), bench_percentile(99),
+            (int)(g.bench.pixels / BENCH_FRAMES));
+}
+
+static void bench(GContext *ctx, GRect bounds, uint8_t reasons)
+{
+    if (g.bench.preset == NUM_BENCH_PRESETS)
+    {
+        render(ctx, bounds, reasons);
+        return;
+    }
+
+    if (g.bench.frame == 0)
+        bench_toggle(g.bench.preset, false);
+
+    for (int i = 0; i < BENCH_CHUNK && g.bench.frame < BENCH_FRAMES; ++i)
     {
-        g.hour = i;
-        for (int j = 0; j < 10; ++j)
+        int f = g.bench.frame++;
+        g.hour = f < 24 * 60 ? f / 60 : 10;
+        g.min = f < 24 * 60 ? f % 60 : 8;
+        g.sec = f < 24 * 60 ? 0 : f - 24 * 60;
+
+        uint16_t start = time_ms(NULL, NULL);
+        if (g.bench.bitmap)
         {
-            g.min = j * 6;
-            render(ctx, bounds);
+#if RASTER_STATS
+            reset_raster_stats();
+#endif
+            draw_frame(g.bench.bitmap, bounds, REDRAW_MINUTE);
         }
+        else
+            render(ctx, bounds, REDRAW_MINUTE);
+        uint16_t end = time_ms(NULL, NULL);
+
+        if (end < start) end += 1000;
+        ++g.bench.hist[end - start < 64 ? end - start : 63];
+        g.bench.ms += end - start;
+#if RASTER_STATS
+        const struct raster_stats *stats = get_raster_stats();
+        for (int j = 0; j < NUM_PRIMS; ++j)
+            g.bench.pixels += stats[j].solid + stats[j].blended +
+                stats[j].cleared;
+#endif
     }
+
+    if (g.bench.frame == BENCH_FRAMES)
+    {
+        bench_report();
+        bench_toggle(g.bench.preset, true);
+        int preset = g.bench.preset + 1;
+        memset(&g.bench, 0, sizeof(g.bench));
+        g.bench.preset = preset;
+        if (g.bench.preset == NUM_BENCH_PRESETS)
+            APP_LOG(APP_LOG_LEVEL_INFO, "bench done");
+    }
+}
+#endif
+
+static void redraw(struct Layer *layer, GContext *ctx)
+{
+    // APP_LOG(APP_LOG_LEVEL_DEBUG, "redraw");
+    GRect bounds = layer_get_unobstructed_bounds(layer);
+    uint8_t reasons = g.redraw ? g.redraw : REDRAW_ALL;
+    g.redraw = 0;
+    ++g.refresh.frames[0][show_seconds() ? REFRESH_SECONDS :
+                          g.refresh.resting ? REFRESH_RESTING :
+                          REFRESH_MINUTES];
+#if BENCH
+    bench(ctx, bounds, reasons);
+#else
+    uint16_t start = time_ms(NULL, NULL);
+    render(ctx, bounds, reasons);
     uint16_t end = time_ms(NULL, NULL);
 
     if (end < start) end += 1000;
-    APP_LOG(APP_LOG_LEVEL_DEBUG, "dt: %d", (end - start) * 10 / 12);
-#else
-    render(ctx, bounds);
+    // rebuilding the static layer is no measure of the frames of the sweep,
+    // nor of those the aliased hands would speed up
+    if (reasons & REDRAW_STATICS)
+        return;
+    if (g.sweep.timer)
+        govern_sweep(end - start);
+    if (end - start > AA_BUDGET_MS && ! g.aa.overrun)
+    {
+        APP_LOG(APP_LOG_LEVEL_DEBUG, "frame took %d ms", end - start);
+        g.aa.overrun = true;
+    }
 #endif
 }
 
-static void tick_handler(struct tm *t, TimeUnits units_changed)
+static void sweep_handler(void *data)
 {
-    if (g.seccount > 0 && --g.seccount == 0) {
-        tick_timer_service_subscribe(MINUTE_UNIT, tick_handler);
+    g.sweep.timer = NULL;
+    if (! sweeping())
+    {
+        g.ms = 0;
+        return;
     }
-    update_time(t);
-    g.status.batstate = battery_state_service_peek();
-    layer_mark_dirty(window_get_root_layer(g.window));
+
+    time_t t;
+    g.ms = time_ms(&t, NULL);
+    g.sec = t % 60;
+    g.sweep.timer = app_timer_register(1000 / g.sweep.rate, sweep_handler,
+                                       NULL);
+    request_redraw(REDRAW_SECOND);
 }
 
-static void tap_handler(AccelAxisType axis, int32_t direction)
+// start or stop the sweeping second hand
+static void update_sweep(void)
 {
-    g.seccount = g.showsec + 1;
-    tick_timer_service_subscribe(SECOND_UNIT, tick_handler);
+    if (sweeping())
+    {
+        if (! g.sweep.timer)
+        {
+            g.sweep.over = g.sweep.under = 0;
+            g.sweep.timer = app_timer_register(0, sweep_handler, NULL);
+        }
+    }
+    else if (g.sweep.timer)
+    {
+        app_timer_cancel(g.sweep.timer);
+        g.sweep.timer = NULL;
+        g.ms = 0;
+    }
 }
 
-static void load_bmpset(struct bmpset *set, uint32_t resid, int size)
+static void tick_handler(struct tm *t, TimeUnits units_changed);
+
+static void subscribe_ticks(void)
 {
-    set->bmp = gbitmap_create_with_resource(resid);
-    struct GRect bounds = gbitmap_get_bounds(set->bmp);
-    set->w = bounds.size.w;
-    set->h = bounds.size.h / size;
+    tick_timer_service_subscribe(show_seconds() ? SECOND_UNIT : MINUTE_UNIT,
+                                 tick_handler);
+#if DEMO || BENCH
+    tick_timer_service_subscribe(SECOND_UNIT, tick_handler);
+#endif
 }
 
-static uint32_t font_to_resource_id(uint8_t fontid)
+// the second hand rests, ticking once a minute, while the wearer sleeps, in
+// quiet time or without activity
+static void update_refresh(void)
 {
-    switch (fontid)
+    bool quiet = g.refresh.asleep || quiet_time_is_active();
+    bool resting = g.showsec != 0 && (g.refresh.idle >= IDLE_MINUTES ||
+                                      (quiet && g.refresh.idle >= WAKE_MINUTES));
+    if (resting == g.refresh.resting)
+        return;
+
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "refresh: %s", resting ? "resting" : "awake");
+    bool sec = show_seconds();
+    g.refresh.resting = resting;
+    if (show_seconds() != sec)
     {
-    case BLOCKY_FONT: return RESOURCE_ID_BLOCKY13;
-    case BLOCKY_SMALL_FONT: return RESOURCE_ID_BLOCKY9;
-    case SMOOTH_FONT: return RESOURCE_ID_DIGITS15;
-    case SMOOTH_SMALL_FONT: return RESOURCE_ID_DIGITS13;
-    default: return 0;
+        subscribe_ticks();
+        update_sweep();
+        request_redraw(REDRAW_SECOND);
     }
 }
 
-static void cleanup_fonts(void)
+static void tick_handler(struct tm *t, TimeUnits units_changed)
 {
-    if (g.day.font.bmp) gbitmap_destroy(g.day.font.bmp);
-    if (g.dialfont.bmp) gbitmap_destroy(g.dialfont.bmp);
+    TRACE_INPUT(trace_tick(t, units_changed));
+    if (g.seccount > 0 && --g.seccount == 0) {
+        tick_timer_service_subscribe(MINUTE_UNIT, tick_handler);
+    }
+    uint8_t reasons = update_time(t);
+    if (reasons & REDRAW_DAY)
+    {
+        memcpy(g.refresh.frames[1], g.refresh.frames[0],
+               sizeof(g.refresh.frames[0]));
+        memset(g.refresh.frames[0], 0, sizeof(g.refresh.frames[0]));
+    }
+    if (units_changed & MINUTE_UNIT)
+    {
+        g.aa.overrun = false;
+        if (g.refresh.idle < UINT16_MAX) ++g.refresh.idle;
+        update_refresh();
+#if TRACE == 1
+        trace_flush();
+#endif
+    }
+    update_sweep();
+    // frames of a sweeping second hand are drawn by its timer
+    if (! g.sweep.timer)
+        request_redraw(reasons);
+    else
+        g.redraw |= reasons;
 }
 
-static void load_fonts(void)
+static void tap_handler(AccelAxisType axis, int32_t direction)
 {
-    cleanup_fonts();
+    TRACE_INPUT(trace_tap(axis, direction));
+    g.refresh.idle = 0;
+    update_refresh();
+    if (g.showsec > 0)
+    {
+        g.seccount = g.showsec + 1;
+        g.sweep.rate = g.sweep.fps;
+        tick_timer_service_subscribe(SECOND_UNIT, tick_handler);
+        update_sweep();
+    }
+}
 
-    uint32_t dayfontid = font_to_resource_id(g.fontconf.day);
-    uint32_t dialfontid = font_to_resource_id(g.fontconf.dial);
+#if defined(PBL_HEALTH)
+static bool asleep(void)
+{
+    return health_service_peek_current_activities() &
+        (HealthActivitySleep | HealthActivityRestfulSleep);
+}
 
-    load_bmpset(&g.day.font, dayfontid, 10);
-    load_bmpset(&g.dialfont, dialfontid, 10);
+// steps and waking up count as activity
+static void health_handler(HealthEventType event, void *context)
+{
+    switch (event)
+    {
+    case HealthEventMovementUpdate:
+    {
+        int32_t steps = health_service_sum_today(HealthMetricStepCount);
+        if (steps != g.refresh.steps)
+        {
+            g.refresh.steps = steps;
+            g.refresh.idle = 0;
+        }
+        break;
+    }
+    case HealthEventSleepUpdate:
+    {
+        bool sleeping = asleep();
+        if (g.refresh.asleep && ! sleeping)
+            g.refresh.idle = 0;
+        g.refresh.asleep = sleeping;
+        break;
+    }
+    default:
+        return;
+    }
+    update_refresh();
 }
+#endif
 
 static void read_settings(void)
 {
@@ -1207,6 +2713,21 @@ static void read_settings(void)
         g.flip_colors_conf = persist_read_int(COLORFLIP_KEY);
         APP_LOG(APP_LOG_LEVEL_DEBUG, "colorflip: %i", g.flip_colors_conf);
     }
+    if (persist_exists(ROUNDEDRECT_KEY))
+    {
+        g.rounded_rect = (uint8_t)persist_read_int(ROUNDEDRECT_KEY);
+        APP_LOG(APP_LOG_LEVEL_DEBUG, "roundedrect: %d", (int)g.rounded_rect);
+    }
+    if (persist_exists(SWEEP_KEY))
+    {
+        g.sweep.fps = (uint8_t)persist_read_int(SWEEP_KEY);
+        APP_LOG(APP_LOG_LEVEL_DEBUG, "sweep: %d", (int)g.sweep.fps);
+    }
+    if (persist_exists(ANTIALIAS_KEY))
+    {
+        g.aa.mode = (uint8_t)persist_read_int(ANTIALIAS_KEY);
+        APP_LOG(APP_LOG_LEVEL_DEBUG, "antialias: %d", (int)g.aa.mode);
+    }
     if (persist_exists(LONGITUDE_KEY))
     {
         g.lon = persist_read_int(LONGITUDE_KEY);
@@ -1217,6 +2738,10 @@ static void read_settings(void)
         g.lat = persist_read_int(LATITUDE_KEY);
         APP_LOG(APP_LOG_LEVEL_DEBUG, "lat: %i", g.lat);
     }
+    if (persist_exists(SUNTIMES_KEY))
+        persist_read_data(SUNTIMES_KEY, &g.suntimes, sizeof(g.suntimes));
+    if (persist_get_size(WARMSTART_KEY) == sizeof(g.warm))
+        persist_read_data(WARMSTART_KEY, &g.warm, sizeof(g.warm));
 }
 
 static void save_settings(void)
@@ -1239,6 +2764,9 @@ static void save_settings(void)
     persist_write_int(LASTTICK_KEY, (int)(unsigned)g.last_tick);
     persist_write_data(FONTS_KEY, &g.fontconf, sizeof(g.fontconf));
     persist_write_int(COLORFLIP_KEY, g.flip_colors_conf);
+    persist_write_int(ROUNDEDRECT_KEY, g.rounded_rect);
+    persist_write_int(SWEEP_KEY, g.sweep.fps);
+    persist_write_int(ANTIALIAS_KEY, g.aa.mode);
 }
 
 static void save_location(void)
@@ -1252,12 +2780,25 @@ static inline uint32_t clamp(uint32_t val, uint32_t max)
     return val < max ? val : max;
 }
 
+// a changed setting which is only saved, without redrawing
+#define CONFIG_SAVED 0x80
+
+// assigns V to C, a change adds the redraw reasons in apply
+#define CONFIG_APPLY(C, V) ({\
+    __typeof__(C) v = (V); \
+    if (C != v) { \
+        C = v; \
+        reasons |= apply; \
+    } \
+})
+
 #define CONFIG_SET_INT(C, K) ({\
     if ((t = dict_find(iter, MESSAGE_KEY_##K))) { \
-        C = t->value->int32; \
+        int32_t n = t->value->int32; \
         if (t->type == TUPLE_CSTRING) \
-            C = atoi(t->value->cstring); \
-        APP_LOG(APP_LOG_LEVEL_DEBUG, #K ": %d", C); \
+            n = atoi(t->value->cstring); \
+        CONFIG_APPLY(C, n); \
+        APP_LOG(APP_LOG_LEVEL_DEBUG, #K ": %d", (int)C); \
     } \
     t != NULL; \
 })
@@ -1268,7 +2809,7 @@ static inline uint32_t clamp(uint32_t val, uint32_t max)
         if (t->type == TUPLE_CSTRING) \
             n = atoi(t->value->cstring); \
         APP_LOG(APP_LOG_LEVEL_DEBUG, #K ": 0x%x", (int)n); \
-        C = clamp(n & 0xFF, M); \
+        CONFIG_APPLY(C, clamp(n & 0xFF, M)); \
     } \
     t != NULL; \
 })
@@ -1276,7 +2817,7 @@ static inline uint32_t clamp(uint32_t val, uint32_t max)
 #define CONFIG_SET_LENGTH(C, K, M) ({\
     if ((t = dict_find(iter, MESSAGE_KEY_##K))) { \
         APP_LOG(APP_LOG_LEVEL_DEBUG, #K ": 0x%x", (int)t->value->uint32); \
-        C = clamp((t->value->uint32 * 255 / 100), M); \
+        CONFIG_APPLY(C, clamp((t->value->uint32 * 255 / 100), M)); \
     } \
     t != NULL; \
 })
@@ -1284,7 +2825,7 @@ static inline uint32_t clamp(uint32_t val, uint32_t max)
 #define CONFIG_SET_WIDTH(C, K, M, S) ({\
     if ((t = dict_find(iter, MESSAGE_KEY_##K))) { \
         APP_LOG(APP_LOG_LEVEL_DEBUG, #K ": 0x%x", (int)t->value->uint32); \
-        C = clamp(t->value->int32 & 0xFF, M) << (FIXED_SHIFT - S); \
+        CONFIG_APPLY(C, clamp(t->value->int32 & 0xFF, M) << (FIXED_SHIFT - S)); \
     } \
     t != NULL; \
 })
@@ -1292,14 +2833,14 @@ static inline uint32_t clamp(uint32_t val, uint32_t max)
 #define CONFIG_SET_TOGGLE(C, K) ({\
     if ((t = dict_find(iter, MESSAGE_KEY_##K))) { \
         APP_LOG(APP_LOG_LEVEL_DEBUG, #K": %d", (int)t->value->int32); \
-        C = t->value->int32 != 0; \
+        CONFIG_APPLY(C, t->value->int32 != 0); \
     } \
     t != NULL; \
 })
 
 #define CONFIG_SET_COLOR(C, K) ({\
     if ((t = dict_find(iter, MESSAGE_KEY_##K))) { \
-        C = GColorFromHEX(t->value->int32).argb; \
+        CONFIG_APPLY(C, GColorFromHEX(t->value->int32).argb); \
         APP_LOG(APP_LOG_LEVEL_DEBUG, #K": 0x%x", (int)C); \
     } \
     t != NULL; \
@@ -1308,13 +2849,35 @@ static inline uint32_t clamp(uint32_t val, uint32_t max)
 static void message_received(DictionaryIterator *iter, void *context)
 {
     Tuple *t;
+    // redraw reasons of changed settings, and those of the settings applied
+    // next
+    uint8_t reasons = 0;
+    uint8_t apply = 0;
+    TRACE_INPUT(trace_message(iter));
 
     if (CONFIG_SET_INT(g.ready, ready))
     {
         check_location_request();
+        outbox_flush();
+        return;
+    }
+
+    if (dict_find(iter, MESSAGE_KEY_frames))
+    {
+        outbox_send(OUTBOX_FRAMES);
         return;
     }
 
+    // sun times of the phone, sent with a position or before they run out
+    bool sun_update = false;
+    if ((t = dict_find(iter, MESSAGE_KEY_suntimes)) &&
+        t->type == TUPLE_BYTE_ARRAY && t->length == sizeof(g.suntimes))
+    {
+        memcpy(&g.suntimes, t->value->data, sizeof(g.suntimes));
+        persist_write_data(SUNTIMES_KEY, &g.suntimes, sizeof(g.suntimes));
+        sun_update = true;
+    }
+
     // check location update
     {
         bool pos_update = false;
@@ -1333,59 +2896,98 @@ static void message_received(DictionaryIterator *iter, void *context)
         {
             g.lon = lon;
             g.lat = lat;
+            // sun times of the old position are calculated again
+            if (! sun_update)
+            {
+                g.suntimes.year = 0;
+                persist_delete(SUNTIMES_KEY);
+            }
             update_day_night();
             save_location();
             return;
         } else if (pos_update) {
             APP_LOG(APP_LOG_LEVEL_DEBUG, "ignoring minor position change");
+        }
+
+        if (pos_update || sun_update)
+        {
+            if (sun_update)
+                update_day_night();
             return;
         }
     }
 
+    // settings kept in temporaries are compared once they are complete
     uint32_t secshow = 0;
     uint32_t sectimeout = 0;
     if (CONFIG_SET_UINT(secshow, showsec, 2) &&
         CONFIG_SET_UINT(sectimeout, sectimeout, 120))
     {
+        int showsec;
         switch (secshow) {
         default:
-        case 0: g.showsec = 0; break;
-        case 1: g.showsec = -1; break;
-        case 2: g.showsec = sectimeout; break;
+        case 0: showsec = 0; break;
+        case 1: showsec = -1; break;
+        case 2: showsec = sectimeout; break;
         }
-        APP_LOG(APP_LOG_LEVEL_DEBUG, "showsec: %d", (int)g.showsec);
+        APP_LOG(APP_LOG_LEVEL_DEBUG, "showsec: %d", showsec);
 
-        g.seccount = 0;
-        if (g.showsec > 0) accel_tap_service_subscribe(tap_handler);
-        else accel_tap_service_unsubscribe();
+        if (g.showsec != showsec)
+        {
+            g.showsec = showsec;
+            g.seccount = 0;
+            g.refresh.idle = 0;
+            g.refresh.resting = false;
+            // taps show the second hand, or wake it from resting
+            if (g.showsec != 0) accel_tap_service_subscribe(tap_handler);
+            else accel_tap_service_unsubscribe();
+
+            subscribe_ticks();
+            reasons |= REDRAW_SECOND;
+        }
+    }
 
-        tick_timer_service_subscribe(show_seconds() ? SECOND_UNIT : MINUTE_UNIT,
-                                     tick_handler);
-     #if DEMO || BENCH
-        tick_timer_service_subscribe(SECOND_UNIT, tick_handler);
-     #endif
+    uint8_t fps = g.sweep.fps;
+    if (CONFIG_SET_UINT(fps, secsweep, 10))
+    {
+        if (fps > 0 && fps < 4) fps = 4;
+        if (g.sweep.fps != fps)
+        {
+            g.sweep.fps = fps;
+            g.sweep.rate = fps;
+            APP_LOG(APP_LOG_LEVEL_DEBUG, "sweep: %d fps", (int)g.sweep.fps);
+            update_sweep();
+            reasons |= REDRAW_SECOND;
+        }
     }
 
-    if (CONFIG_SET_TOGGLE(g.day.show, dayshow))
-        g.day.update = true;
+    // the background is cleared entirely
+    apply = REDRAW_PALETTE;
+    CONFIG_SET_COLOR(g.bgcol, bgcol);
 
+    // the static layer is redrawn, AA and outlines also apply to its ticks
+    apply = REDRAW_CONFIG;
+    CONFIG_SET_TOGGLE(g.day.show, dayshow);
     CONFIG_SET_TOGGLE(g.outline, outline);
+    uint8_t aa = g.aa.mode;
+    CONFIG_SET_UINT(g.aa.mode, antialias, AA_NEVER);
+    if (g.aa.mode != aa)
+        g.aa.overrun = false;
 
-    if (CONFIG_SET_COLOR(g.bgcol, bgcol))
-    {
-        clear_bg();
-    }
-
+    // only the hands, they are drawn every frame
+    apply = REDRAW_SECOND;
     CONFIG_SET_TOGGLE(g.hourhand_below, hourbelowmin);
 
     CONFIG_SET_LENGTH(g.hour_hand.r0, hourext, 85);
     CONFIG_SET_LENGTH(g.hour_hand.r1, hourlen, 230);
     CONFIG_SET_WIDTH(g.hour_hand.w, hourwidth, 16, 0);
+    CONFIG_SET_UINT(g.hour_hand.shape, hourshape, HAND_LOZENGE);
     CONFIG_SET_COLOR(g.hour_hand.col, hourcol);
 
     CONFIG_SET_LENGTH(g.min_hand.r0, minext, 85);
     CONFIG_SET_LENGTH(g.min_hand.r1, minlen, 230);
     CONFIG_SET_WIDTH(g.min_hand.w, minwidth, 16, 0);
+    CONFIG_SET_UINT(g.min_hand.shape, minshape, HAND_LOZENGE);
     CONFIG_SET_COLOR(g.min_hand.col, mincol);
 
     CONFIG_SET_LENGTH(g.sec_hand.r0, secext, 85);
@@ -1398,27 +3000,47 @@ static void message_received(DictionaryIterator *iter, void *context)
     CONFIG_SET_WIDTH(g.center[1].r, seccenterwidth, 32, 1);
     CONFIG_SET_COLOR(g.center[1].col, seccentercol);
 
+    apply = 0;
+    uint32_t dialshape = 0;
+    uint32_t dialcorner = 0;
+    if (CONFIG_SET_UINT(dialshape, dialshape, 1) &&
+        CONFIG_SET_UINT(dialcorner, dialcorner, 90))
+    {
+        // a corner radius of at least 1 keeps the rect dial enabled
+        apply = REDRAW_CONFIG;
+        CONFIG_APPLY(g.rounded_rect,
+                     dialshape ? (dialcorner > 0 ? dialcorner : 1) : 0);
+    }
+
+    apply = 0;
     uint32_t hourtick = 0xFFFFFFFF;
     if (CONFIG_SET_UINT(hourtick, hourtickshow, 2))
     {
         APP_LOG(APP_LOG_LEVEL_DEBUG, "hourtick: 0x%x", (int)hourtick);
-        g.hour_tick.show = hourtick != 0;
+        apply = REDRAW_CONFIG;
+        CONFIG_APPLY(g.hour_tick.show, hourtick != 0);
     }
+    apply = REDRAW_CONFIG;
     CONFIG_SET_COLOR(g.hour_tick.col, hourtickcol);
     CONFIG_SET_WIDTH(g.hour_tick.w, hourtickwidth, 16, 0);
     CONFIG_SET_WIDTH(g.hour_tick.h, hourticklen, 32, 0);
 
+    apply = 0;
     uint32_t mintick = 0xFFFFFFFF;
     if (CONFIG_SET_UINT(mintick, mintickshow, 2))
-        g.min_tick.show = mintick != 0;
+    {
+        apply = REDRAW_CONFIG;
+        CONFIG_APPLY(g.min_tick.show, mintick != 0);
+    }
 
+    apply = REDRAW_CONFIG;
     CONFIG_SET_COLOR(g.min_tick.col, mintickcol);
     CONFIG_SET_WIDTH(g.min_tick.w, mintickwidth, 16, 0);
     CONFIG_SET_WIDTH(g.min_tick.h, minticklen, 32, 0);
 
     if (mintick != 0xFFFFFFFF && hourtick != 0xFFFFFFFF)
     {
-        g.last_tick = (hourtick & 1) | ((mintick & 1) << 1);
+        CONFIG_APPLY(g.last_tick, (hourtick & 1) | ((mintick & 1) << 1));
         APP_LOG(APP_LOG_LEVEL_DEBUG, "lasttick: 0x%x", (int)g.last_tick);
     }
 
@@ -1427,92 +3049,231 @@ static void message_received(DictionaryIterator *iter, void *context)
     CONFIG_SET_COLOR(g.daycolors.sunday, sundaycol);
     CONFIG_SET_COLOR(g.daycolors.today, todaycol);
 
+    // which status icons show is part of the static key
+    apply = REDRAW_STATUS;
     CONFIG_SET_TOGGLE(g.statusconf.showconn, statusshow);
+    CONFIG_SET_UINT(g.statusconf.warnlevel, batwarn, 100);
+    apply = REDRAW_CONFIG;
     CONFIG_SET_COLOR(g.statusconf.color, statuscol);
+    apply = CONFIG_SAVED;
     CONFIG_SET_UINT(g.statusconf.vibepattern, statusvibe, 3);
-    CONFIG_SET_UINT(g.statusconf.warnlevel, batwarn, 100);
 
+    apply = 0;
     bool showhournum = false, showminnum = false;
     if (CONFIG_SET_TOGGLE(showhournum, hournumshow) &&
         CONFIG_SET_TOGGLE(showminnum, minnumshow))
     {
-        g.dialnumbers.show = (int)showhournum | ((int)showminnum << 1);
+        apply = REDRAW_CONFIG;
+        CONFIG_APPLY(g.dialnumbers.show,
+                     (int)showhournum | ((int)showminnum << 1));
     }
+    apply = REDRAW_CONFIG;
     CONFIG_SET_COLOR(g.dialnumbers.col, dialnumcol);
 
-    if (CONFIG_SET_UINT(g.flip_colors_conf, colorflip, 2))
+    // a flip of the colors requests its own redraw
+    apply = CONFIG_SAVED;
+    uint8_t flipconf = g.flip_colors_conf;
+    CONFIG_SET_UINT(g.flip_colors_conf, colorflip, 2);
+    if (g.flip_colors_conf != flipconf)
     {
         update_day_night();
         check_location_request();
     }
 
-    bool fontsupdate = false;
-
+    // fonts are only decoded again if they changed
+    apply = 0;
+    uint8_t dayfontid = g.fontconf.day;
+    uint8_t dialfontid = g.fontconf.dial;
     uint32_t dayfont = 0;
     if (CONFIG_SET_UINT(dayfont, dayfont, 1))
-    {
         g.fontconf.day = dayfont * 2;
-        fontsupdate = true;
-    }
 
     uint32_t dialfont = 0;
     if (CONFIG_SET_UINT(dialfont, dialfont, 1))
-    {
         g.fontconf.dial = dialfont * 2 + 1;
-        fontsupdate = true;
-    }
 
-    if (fontsupdate)
-        load_fonts();
+    if (g.fontconf.day != dayfontid || g.fontconf.dial != dialfontid)
+        reasons |= REDRAW_CONFIG;
 
-    save_settings();
+    // an unchanged config is neither saved nor redrawn
+    if (reasons)
+        save_settings();
+    if (reasons & ~CONFIG_SAVED)
+        request_redraw(reasons & ~CONFIG_SAVED);
+}
 
-    layer_mark_dirty(window_get_root_layer(g.window));
+// applies a new status, only redraws if the status icons change
+static void update_status(BatteryChargeState batstate, bool connected)
+{
+    bool battery = show_battery();
+    bool disconnected = show_disconnected();
+    uint8_t percent = g.status.batstate.charge_percent;
+
+    g.status.batstate = batstate;
+    g.status.connected = connected;
+    // the sweep and AA of the hands depend on the charge as well, the sweep
+    // is stopped by its own timer, AA changes with the next frame
+    update_sweep();
+
+    if (show_battery() != battery || show_disconnected() != disconnected ||
+        (battery && batstate.charge_percent != percent))
+        request_redraw(REDRAW_STATUS);
+}
+
+static void battery_handler(BatteryChargeState batstate)
+{
+    TRACE_INPUT(trace_battery(batstate));
+    update_status(batstate, g.status.connected);
+}
+
+static void debounce_handler(void *data)
+{
+    g.status.debounce = NULL;
+    bool connected = g.status.reported;
+    if (connected == g.status.connected)
+        return;
+
+    if (! connected && g.statusconf.vibepattern && ! quiet_time_is_active())
+    {
+        switch (g.statusconf.vibepattern)
+        {
+        case 0: break;
+        default:
+        case 1: vibes_short_pulse(); break;
+        case 2: vibes_long_pulse(); break;
+        case 3: vibes_double_pulse(); break;
+        }
+    }
+    update_status(g.status.batstate, connected);
 }
 
+// flapping connections restart the debounce timer, so only a state which
+// held for CONNECTION_DEBOUNCE_MS is shown
 static void connection_handler(bool connected)
 {
+    TRACE_INPUT(trace_connection(connected));
     APP_LOG(APP_LOG_LEVEL_DEBUG, "bt: %s",
             connected ? "connected" : "disconnected");
-    if (connected != g.status.connected)
+    g.status.reported = connected;
+    if (g.status.debounce)
+        app_timer_reschedule(g.status.debounce, CONNECTION_DEBOUNCE_MS);
+    else if (connected != g.status.connected)
+        g.status.debounce = app_timer_register(CONNECTION_DEBOUNCE_MS,
+                                               debounce_handler, NULL);
+}
+
+static void unobstructed_change_handler(AnimationProgress progress,
+                                        void *context)
+{
+    // render picks up the new bounds, only the rows between the old and the
+    // new bottom edge are cleared entirely
+    request_redraw(REDRAW_LAYOUT);
+}
+
+static void unobstructed_did_change_handler(void *context)
+{
+    request_redraw(REDRAW_LAYOUT);
+}
+
+#if TRACE == 2
+// feeds the recorded inputs to their handlers, one per period
+static void trace_replay_handler(void *data)
+{
+    g.trace.timer = NULL;
+    int pos = g.trace.tail;
+    if (pos == g.trace.head)
     {
-        g.status.connected = connected;
-        if (! connected && g.statusconf.vibepattern &&
-            ! quiet_time_is_active())
-        {
-            switch (g.statusconf.vibepattern)
-            {
-            case 0: break;
-            default:
-            case 1: vibes_short_pulse(); break;
-            case 2: vibes_long_pulse(); break;
-            case 3: vibes_double_pulse(); break;
-            }
-        }
-        layer_mark_dirty(window_get_root_layer(g.window));
+        APP_LOG(APP_LOG_LEVEL_INFO, "replay: done");
+        return;
+    }
+    g.trace.tail = trace_next(pos);
+
+    const uint8_t *rec = g.trace.buf + pos + TRACE_RECORD_HEADER;
+    int n = g.trace.buf[pos + 1] | (g.trace.buf[pos + 2] << 8);
+    g.trace.replaying = true;
+    switch (g.trace.buf[pos])
+    {
+    case TRACE_TICK:
+    {
+        struct trace_tick tick;
+        memcpy(&tick, rec, sizeof(tick));
+        struct tm t = {
+            .tm_sec = tick.sec,
+            .tm_min = tick.min,
+            .tm_hour = tick.hour,
+            .tm_mday = tick.mday,
+            .tm_mon = tick.mon,
+            .tm_year = tick.year,
+            .tm_wday = tick.wday,
+            .tm_yday = tick.yday,
+            .tm_gmtoff = tick.gmtoff,
+        };
+        tick_handler(&t, tick.units);
+        break;
+    }
+    case TRACE_CONNECTION:
+        connection_handler(rec[0]);
+        break;
+    case TRACE_BATTERY:
+    {
+        BatteryChargeState batstate;
+        memcpy(&batstate, rec, sizeof(batstate));
+        battery_handler(batstate);
+        break;
+    }
+    case TRACE_MESSAGE:
+    {
+        DictionaryIterator iter;
+        dict_read_begin_from_buffer(&iter, rec, n);
+        message_received(&iter, NULL);
+        break;
     }
+    case TRACE_TAP:
+        tap_handler(rec[0], (int8_t)rec[1]);
+        break;
+    }
+    g.trace.replaying = false;
+
+    g.trace.timer = app_timer_register(TRACE_REPLAY_MS, trace_replay_handler,
+                                       NULL);
 }
+#endif
 
 static void window_load(Window *window)
 {
     Layer *window_layer = window_get_root_layer(window);
     layer_set_update_proc(window_layer, redraw);
 
-    if (g.showsec > 0) accel_tap_service_subscribe(tap_handler);
+    if (g.showsec != 0) accel_tap_service_subscribe(tap_handler);
 
-    tick_timer_service_subscribe(show_seconds() ? SECOND_UNIT : MINUTE_UNIT,
-                                 tick_handler);
-#if DEMO || BENCH
-    tick_timer_service_subscribe(SECOND_UNIT, tick_handler);
+    subscribe_ticks();
+#if defined(PBL_HEALTH)
+    g.refresh.asleep = asleep();
+    g.refresh.steps = health_service_sum_today(HealthMetricStepCount);
+    health_service_events_subscribe(health_handler, NULL);
 #endif
     clear_bg();
+    time_t t = time(NULL);
+    request_redraw(update_time(localtime(&t)) | REDRAW_LAYOUT);
     g.status.batstate = battery_state_service_peek();
+    battery_state_service_subscribe(battery_handler);
 
     g.status.connected = connection_service_peek_pebble_app_connection();
+    g.status.reported = g.status.connected;
     ConnectionHandlers handlers = {
         .pebble_app_connection_handler = connection_handler,
     };
     connection_service_subscribe(handlers);
+    UnobstructedAreaHandlers uahandlers = {
+        .change = unobstructed_change_handler,
+        .did_change = unobstructed_did_change_handler,
+    };
+    unobstructed_area_service_subscribe(uahandlers, NULL);
+    update_sweep();
+#if TRACE == 2
+    g.trace.timer = app_timer_register(TRACE_REPLAY_MS, trace_replay_handler,
+                                       NULL);
+#endif
 }
 
 static void window_unload(Window *window)
@@ -1521,15 +3282,57 @@ static void window_unload(Window *window)
     connection_service_unsubscribe();
     tick_timer_service_unsubscribe();
     accel_tap_service_unsubscribe();
+#if defined(PBL_HEALTH)
+    health_service_events_unsubscribe();
+#endif
+    unobstructed_area_service_unsubscribe();
+    if (g.sweep.timer)
+    {
+        app_timer_cancel(g.sweep.timer);
+        g.sweep.timer = NULL;
+    }
+    if (g.status.debounce)
+    {
+        app_timer_cancel(g.status.debounce);
+        g.status.debounce = NULL;
+    }
+#if TRACE == 1
+    trace_flush();
+#elif TRACE == 2
+    if (g.trace.timer)
+    {
+        app_timer_cancel(g.trace.timer);
+        g.trace.timer = NULL;
+    }
+#endif
     clear_bg();
+    free(g.statics.rows);
+    free(g.statics.spans);
+    free(g.statics.runs);
+    g.statics.rows = NULL;
+    g.statics.spans = NULL;
+    g.statics.runs = NULL;
+    g.statics.num_rows = 0;
+    g.statics.size = 0;
 }
 
 static void init()
 {
+    STARTUP_MARK(STARTUP_INIT);
     app_message_register_inbox_received(message_received);
     // needed inbox size, see note at dict_calc_buffer_size
     uint32_t insize = NUM_MESSAGE_KEYS * (7 + sizeof(int32_t)) + 1;
-    uint32_t outsize = 1 * (7 + sizeof(int32_t)) + 1;
+    // the largest of the messages built by outbox_write
+    uint32_t outsize = 4 * (7 + sizeof(int32_t)) + 1;
+    uint32_t framessize = 2 * 7 + sizeof(g.refresh.frames) +
+        4 * sizeof(uint16_t) + 1;
+    if (outsize < framessize) outsize = framessize;
+#if PROFILE
+    if (outsize < 7 + sizeof(g.prof.hist[0]) + 1)
+        outsize = 7 + sizeof(g.prof.hist[0]) + 1;
+#endif
+    app_message_register_outbox_sent(outbox_sent_handler);
+    app_message_register_outbox_failed(outbox_failed_handler);
     app_message_open(insize, outsize);
 
     g.bgcol = 0xC0;
@@ -1575,16 +3378,23 @@ static void init()
     g.dialnumbers.show = 1;
     g.fontconf.day = SMOOTH_FONT;
     g.fontconf.dial = SMOOTH_SMALL_FONT;
+    g.loaded_fonts.day = NO_FONT;
+    g.loaded_fonts.dial = NO_FONT;
     g.flip_colors_conf = NO_COLOR_FLIP;
     g.flip_colors = false;
-    // g.rounded_rect = 0;
+    g.rounded_rect = 0;
+    g.sweep.fps = 0;
+    g.aa.mode = AA_AUTO;
 
     g.lon = INVALID_DEGREE;
     g.lat = INVALID_DEGREE;
 
     read_settings();
-
-    load_fonts();
+    g.sweep.rate = g.sweep.fps;
+#if TRACE
+    trace_load();
+#endif
+    STARTUP_MARK(STARTUP_SETTINGS);
 
     g.window = window_create();
     window_set_window_handlers(g.window,
@@ -1592,12 +3402,15 @@ static void init()
                                    .load = window_load, .unload = window_unload,
                                });
     window_stack_push(g.window, true);
+    STARTUP_MARK(STARTUP_WINDOW);
 }
 
 static void deinit()
 {
     window_destroy(g.window);
     cleanup_fonts();
+    if (g.warm_changed)
+        persist_write_data(WARMSTART_KEY, &g.warm, sizeof(g.warm));
 }
 
 int main(void)
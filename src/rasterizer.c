@@ -48,27 +48,139 @@ static inline int32_t mini(int32_t a, int32_t b)
     return a < b ? a : b;
 }
 
-int32_t sqrti(int32_t i)
+static inline int32_t maxi(int32_t a, int32_t b)
 {
-    int32_t r = 0;
-    int32_t n = 1 << 30;
+    return a > b ? a : b;
+}
+
+static struct
+{
+    int x0, y0, x1, y1;
+} clip = { 0, 0, 0, 0 };
+
+void set_clip_rect(int x0, int y0, int x1, int y1)
+{
+    clip.x0 = x0;
+    clip.y0 = y0;
+    clip.x1 = x1;
+    clip.y1 = y1;
+}
+
+static bool antialias = true;
+
+void set_antialias(bool aa)
+{
+    antialias = aa;
+}
+
+#if RASTER_8BIT && RASTER_1BIT
+bool is_1bit(struct GBitmap *bmp)
+{
+    return gbitmap_get_format(bmp) == GBitmapFormat1Bit;
+}
+#endif
+
+#if RASTER_STATS
+static struct raster_stats stats[NUM_PRIMS];
+static int stats_prim;
+static uint8_t *overdraw;
+static int overdraw_stride;
+
+const struct raster_stats *get_raster_stats(void)
+{
+    return stats;
+}
+
+void reset_raster_stats(void)
+{
+    memset(stats, 0, sizeof(stats));
+}
 
-    if (i <= 0) return 0;
-    while (n > i) n /= 4;
+void set_raster_overdraw(uint8_t *counts, int stride)
+{
+    overdraw = counts;
+    overdraw_stride = stride;
+}
 
-    while (n != 0)
+static inline void count_pixel(int y, int x)
+{
+    uint8_t *c = overdraw + y * overdraw_stride + x;
+    if (*c < 255) ++*c;
+}
+
+static void count_span(uint32_t *counter, int y, int x0, int x1)
+{
+    if (x0 >= x1) return;
+    *counter += x1 - x0;
+    if (overdraw)
+        for (int x = x0; x < x1; ++x) count_pixel(y, x);
+}
+
+static void count_blended(int y, int i, uint32_t cov)
+{
+    for (int k = 0; k < 4; ++k)
     {
-        int32_t k = n + r;
-        if (k <= i)
+        if (cov & (0xFFu << (k * 8)))
         {
-            i -= k;
-            r = r / 2 + n;
+            ++stats[stats_prim].blended;
+            if (overdraw) count_pixel(y, i * 4 + k);
         }
-        else
-            r /= 2;
-        n /= 4;
     }
-    return r;
+}
+
+static void count_blended_bits(int y, int i, uint32_t bits)
+{
+    for (int k = 0; k < 32; ++k)
+    {
+        if (bits & (1u << k))
+        {
+            ++stats[stats_prim].blended;
+            if (overdraw) count_pixel(y, i * 32 + k);
+        }
+    }
+}
+
+void count_cleared(int y, int x0, int x1)
+{
+    ++stats[PRIM_CLEAR].rows;
+    count_span(&stats[PRIM_CLEAR].cleared, y, x0, x1);
+}
+
+#define STATS_PRIM(prim) (stats_prim = (prim), ++stats[prim].calls)
+#define STATS_ROW() (++stats[stats_prim].rows)
+#define STATS_SOLID(y, x0, x1) count_span(&stats[stats_prim].solid, y, x0, x1)
+#define STATS_BLENDED(y, i, cov) count_blended(y, i, cov)
+#define STATS_BLENDED_BITS(y, i, bits) count_blended_bits(y, i, bits)
+#else
+#define STATS_PRIM(prim)
+#define STATS_ROW()
+#define STATS_SOLID(y, x0, x1)
+#define STATS_BLENDED(y, i, cov)
+#define STATS_BLENDED_BITS(y, i, bits)
+#endif
+
+static inline int clip_top(int y)
+{
+    return y < clip.y0 ? clip.y0 : y;
+}
+
+static inline int clip_bottom(int y)
+{
+    return y > clip.y1 ? clip.y1 : y;
+}
+
+static inline bool row_clipped(int y)
+{
+    return y < clip.y0 || y >= clip.y1;
+}
+
+// visible part [min_x, max_x] of a row, limited to the clip rect
+static inline GBitmapDataRowInfo get_clipped_row(struct GBitmap *bmp, int y)
+{
+    GBitmapDataRowInfo row = gbitmap_get_data_row_info(bmp, (unsigned)y);
+    if (row.min_x < clip.x0) row.min_x = clip.x0;
+    if (row.max_x >= clip.x1) row.max_x = clip.x1 - 1;
+    return row;
 }
 
 bool dark_color(uint8_t color)
@@ -118,70 +230,410 @@ uint8_t flip_color(uint8_t col)
     return (col & 0xC0) | (r << 4) | (g << 2) | b;
 }
 
+/*
+ * 1 bit rows hold pixel x in bit x & 31 of word x >> 5. Colors are reduced to
+ * 5 gray levels and drawn as 2x2 ordered dither patterns, where a pixel is
+ * set if its threshold in the pattern is below the level.
+ */
+static const uint32_t dither_bits[2][5] = {
+    { 0, 0x55555555, 0x55555555, 0xFFFFFFFF, 0xFFFFFFFF },
+    { 0, 0, 0xAAAAAAAA, 0xAAAAAAAA, 0xFFFFFFFF },
+};
+
+static inline int gray_level(uint8_t color)
+{
+    uint8_t r = (color >> 4) & 0x3;
+    uint8_t g = (color >> 2) & 0x3;
+    uint8_t b = color & 0x3;
+    return ((r * 3 + g * 6 + b * 2) * 4 + 8) / 33;
+}
+
+// pattern of color in row y
+static inline uint32_t dither_color(uint8_t color, int y)
+{
+    return dither_bits[y & 1][gray_level(color)];
+}
+
+// sets [x0, x1) to the bits of pattern
+static inline void fill_bits(uint8_t *line, int x0, int x1, uint32_t pattern)
+{
+    if (x0 >= x1) return;
+    uint32_t *words = (uint32_t *)line;
+    int i = x0 >> 5;
+    int i1 = (x1 - 1) >> 5;
+    uint32_t m = ~0u << (x0 & 0x1F);
+    for (; i < i1; ++i, m = ~0u)
+        words[i] = (words[i] & ~m) | (pattern & m);
+    m &= ~0u >> (0x1F - ((x1 - 1) & 0x1F));
+    words[i] = (words[i] & ~m) | (pattern & m);
+}
+
+static inline void put_bit(uint8_t *line, int x, uint32_t pattern)
+{
+    uint32_t *word = (uint32_t *)line + (x >> 5);
+    uint32_t bit = 1u << (x & 0x1F);
+    *word = (*word & ~bit) | (pattern & bit);
+}
+
+// fills [x0, x1) of row y in either format
+static inline void fill_row(uint8_t *line, bool bits, int y, int x0, int x1,
+                            uint8_t color)
+{
+    if (bits)
+        fill_bits(line, x0, x1, dither_color(color, y));
+    else
+        for (int x = x0; x < x1; ++x) line[x] = color;
+}
+
+// fills [x0, x1) of row y, limited to its visible part, see get_clipped_row()
+static inline void fill_clipped(GBitmapDataRowInfo row, bool bits, int y,
+                                int x0, int x1, uint8_t color)
+{
+    if (x0 < row.min_x) x0 = row.min_x;
+    if (x1 > row.max_x + 1) x1 = row.max_x + 1;
+    if (x0 < x1) fill_row(row.data, bits, y, x0, x1, color);
+}
+
 void draw_box(struct GBitmap *bmp, uint8_t color, int x, int y, int w, int h)
 {
-    for (int i = 0; i < h; ++i)
-    {
-        uint8_t *line = gbitmap_get_data_row_info(bmp, (unsigned)(y + i)).data;
-        for (int j = 0; j < w; ++j)
-            line[x + j] = color;
-    }
+    bool bits = is_1bit(bmp);
+    int y1 = clip_bottom(y + h);
+    for (int py = clip_top(y); py < y1; ++py)
+        fill_clipped(get_clipped_row(bmp, py), bits, py, x, x + w, color);
+}
+
+void draw_span(struct GBitmap *bmp, uint8_t color, int y, int x0, int x1)
+{
+    if (x0 >= x1) return;
+    uint8_t *line = gbitmap_get_data_row_info(bmp, (unsigned)y).data;
+    if (is_1bit(bmp))
+        fill_bits(line, x0, x1, dither_color(color, y));
+    else
+        memset(line + x0, color, x1 - x0);
+}
+
+/*
+ * The drawing primitives below are instantiated as separate kernels for each
+ * combination of background (blend vs. blend_inv) and outline. Both are
+ * constant for one primitive, so the kernel is chosen once per call and the
+ * per pixel loops do not branch on them. Without anti-aliasing, a single
+ * kernel fills the spans of pixels whose center is inside.
+ */
+
+// width of anti-aliased border
+#define AA_SMOOTH 2
+
+/*
+ * Anti-aliased bands are blended a word at a time. The coverage of up to four
+ * pixels is collected first, pixels outside of the band keep coverage 0 and
+ * stay unchanged. Words reaching over the visible part of the row [xmin, xmax)
+ * are only read and written at the covered pixels.
+ */
+
+static inline uint32_t load_aa4(const uint8_t *line, int i, uint32_t cov)
+{
+    uint32_t x4 = 0;
+    for (int k = 0; k < 4; ++k)
+        if (cov & (0xFFu << (k * 8)))
+            x4 |= (uint32_t)line[i * 4 + k] << (k * 8);
+    return x4;
+}
+
+static inline void store_aa4(uint8_t *line, int i, uint32_t x4, uint32_t cov)
+{
+    for (int k = 0; k < 4; ++k)
+        if (cov & (0xFFu << (k * 8)))
+            line[i * 4 + k] = x4 >> (k * 8);
 }
 
-#define DRAW_CIRCLE_LINES(y0, y1, blend) ({\
-    for (int y = y0; y < y1; ++y) \
+#define AA_STORE(blend4) ({\
+    int i = x >> 2; \
+    STATS_BLENDED(y, i, cov); \
+    if (i * 4 >= xmin && i * 4 + 4 <= xmax) \
+    { \
+        uint32_t x4 = ((uint32_t *)line)[i]; \
+        ((uint32_t *)line)[i] = blend4; \
+    } \
+    else \
+    { \
+        uint32_t x4 = load_aa4(line, i, cov); \
+        store_aa4(line, i, blend4, cov); \
+    } \
+    cov = 0; \
+})
+
+/*
+ * The row loops below take the pixel format as a prefix of the macros that
+ * access pixels: BYTE for 8 bit rows and BIT for 1 bit rows. Each format has
+ * a setup per kernel and row, band loops and a fill of the solid span.
+ */
+
+#define BYTE_SETUP() \
+    const uint32_t col4 = color * 0x01010101u; \
+    (void)col4
+
+#define BYTE_ROW(y)
+
+#define BYTE_PENDING() uint32_t cov = 0
+
+#define BYTE_FILL(xend) for (; x < xend; ++x) line[x] = color
+
+// band entering a span, stops in front of the first fully covered pixel
+#define BYTE_BAND_ENTER(xend, coverage, blend4) ({\
+    uint32_t cov = 0; \
+    for (; x < xend; ++x) \
+    { \
+        int32_t a = coverage; \
+        if (a >= 4) break; \
+        if (a > 0) cov |= (uint32_t)a << ((x & 0x3) * 8); \
+        if ((x & 0x3) == 0x3 && cov) AA_STORE(blend4); \
+    } \
+    if (cov) AA_STORE(blend4); \
+})
+
+// band leaving a span, optionally stops at the first uncovered pixel
+#define BYTE_BAND_LEAVE(xend, coverage, blend4, stop) ({\
+    uint32_t cov = 0; \
+    for (; x < xend; ++x) \
+    { \
+        int32_t a = coverage; \
+        if (a <= 0) \
+        { \
+            if (stop) break; \
+        } \
+        else \
+            cov |= (uint32_t)(a < 4 ? a : 4) << ((x & 0x3) * 8); \
+        if ((x & 0x3) == 0x3 && cov) AA_STORE(blend4); \
+    } \
+    if (cov) AA_STORE(blend4); \
+})
+
+/*
+ * 1 bit bands collect 32 pixels per word. The dither patterns stand in for
+ * the coverage levels 1 to 3, a pixel takes the pattern of the color where
+ * its threshold is below the coverage. With a rim, pixels which are not fully
+ * covered are drawn in its color instead, like the darker or lighter edges of
+ * the outline blends.
+ */
+
+enum
+{
+    RIM_NONE,
+    RIM_BLACK,
+    RIM_WHITE,
+};
+
+#define BIT_SETUP() const int level = gray_level(color)
+
+#define BIT_ROW(y) \
+    const uint32_t *dither = dither_bits[(y) & 1]; \
+    const uint32_t pat = dither[level]
+
+// pixels set to the pattern and to the rim
+#define BIT_PENDING() uint32_t cov = 0, rim = 0
+
+#define BIT_FILL(xend) ({\
+    if (x < xend) \
+    { \
+        fill_bits(line, x, xend, pat); \
+        x = xend; \
+    } \
+})
+
+#define BIT_ADD(coverage, rim_color) ({\
+    int32_t c = coverage; \
+    uint32_t bit = 1u << (x & 0x1F); \
+    if ((rim_color) == RIM_NONE) \
+        cov |= dither[c] & bit; \
+    else if (c >= 4) \
+        cov |= bit; \
+    else if (c > 0) \
+        rim |= bit; \
+})
+
+#define BIT_STORE(rim_color) ({\
+    uint32_t *word = (uint32_t *)line + (x >> 5); \
+    STATS_BLENDED_BITS(y, x >> 5, cov | rim); \
+    *word = (*word & ~(cov | rim)) | (pat & cov) | \
+        ((rim_color) == RIM_WHITE ? rim : 0); \
+    cov = 0; \
+    rim = 0; \
+})
+
+#define BIT_BAND_ENTER(xend, coverage, rim_color) ({\
+    BIT_PENDING(); \
+    for (; x < xend; ++x) \
+    { \
+        int32_t a = coverage; \
+        if (a >= 4) break; \
+        if (a > 0) BIT_ADD(a, rim_color); \
+        if ((x & 0x1F) == 0x1F && (cov | rim)) BIT_STORE(rim_color); \
+    } \
+    if (cov | rim) BIT_STORE(rim_color); \
+})
+
+#define BIT_BAND_LEAVE(xend, coverage, rim_color, stop) ({\
+    BIT_PENDING(); \
+    for (; x < xend; ++x) \
     { \
-        uint8_t *line = gbitmap_get_data_row_info(bmp, (unsigned)y).data; \
-        int32_t fy = fixed(y) + half - cy; \
-        int rx = sqrti(r2 - fy * fy); \
+        int32_t a = coverage; \
+        if (a <= 0) \
+        { \
+            if (stop) break; \
+        } \
+        else \
+            BIT_ADD(a < 4 ? a : 4, rim_color); \
+        if ((x & 0x1F) == 0x1F && (cov | rim)) BIT_STORE(rim_color); \
+    } \
+    if (cov | rim) BIT_STORE(rim_color); \
+})
+
+#define CIRCLE_COVERAGE ({\
+    int32_t dx = fixed(x) + half - cx; \
+    int32_t ds = dx * dx + dy * dy; \
+    recip_div((r2 - ds) * 4, rcp); \
+})
+
+#define DRAW_CIRCLE_LINES(y0, y1, fmt, aa, blend4) ({\
+    for (int y = clip_top(y0); y < clip_bottom(y1); ++y) \
+    { \
+        GBitmapDataRowInfo row = get_clipped_row(bmp, y); \
+        uint8_t *line = row.data; \
+        int xmin = row.min_x; \
+        int xmax = row.max_x + 1; \
+        fmt##_ROW(y); \
+        STATS_ROW(); \
         int32_t dy = fixed(y) + half - cy; \
-        int x, x0 = fixedfloor(cx - rx); \
-        int x1 = fixedfloor(cx + rx + half); \
-        for (x = x0; x < x1; ++x) \
+        int32_t rx = sqrti(r2 - dy * dy); \
+        int x0 = maxi(fixedfloor(cx - rx), xmin); \
+        int x1 = mini(fixedfloor(cx + rx + half), xmax); \
+        /* fully covered where dx * dx + dy * dy <= r2 - rs, the center */ \
+        /* of aliased pixels at half of the coverage */ \
+        int32_t ri = r2 - (aa ? rs : rs / 2) - dy * dy; \
+        int xs0 = x1, xs1 = x1; \
+        if (ri >= 0) \
         { \
-            int32_t dx = fixed(x) + half - cx; \
-            int32_t ds = dx * dx + dy * dy; \
-            int32_t a = (r2 - ds) * 4 / rs; \
-            if (a <= 0) continue; \
-            if (a < 4) line[x] = blend(line[x], color, a, od); \
-            else break; \
+            ri = sqrti(ri); \
+            xs0 = maxi((cx - half - ri + 0xF) >> FIXED_SHIFT, x0); \
+            xs1 = mini(((cx - half + ri) >> FIXED_SHIFT) + 1, x1); \
         } \
+        int x = aa ? x0 : xs0; \
+        if (aa) fmt##_BAND_ENTER(mini(xs0, x1), CIRCLE_COVERAGE, blend4); \
  \
-        int dxs = x - x0; \
-        for (; x < x1 - dxs; ++x) line[x] = color; \
+        STATS_SOLID(y, x, xs1); \
+        fmt##_FILL(xs1); \
  \
-        for (; x < x1; ++x) \
-        { \
-            int32_t dx = fixed(x) + half - cx; \
-            int32_t ds = dx * dx + dy * dy; \
-            int32_t a = (r2 - ds) * 4 / rs; \
-            if (a <= 0) break; \
-            if (a < 4) line[x] = blend(line[x], color, a, od); \
-            else line[x] = color; \
-        } \
+        if (aa) fmt##_BAND_LEAVE(x1, CIRCLE_COVERAGE, blend4, true); \
     } \
 })
 
-void draw_circle(struct GBitmap *bmp, uint8_t color, int32_t cx, int32_t cy,
-                 int32_t r, bool outline, bool dark_bg)
+struct circle_params
+{
+    struct GBitmap *bmp;
+    uint32_t colors;
+    int32_t cx, cy;
+    int32_t r2, rs;
+    int y0, y1;
+};
+
+typedef void (*circle_kernel)(const struct circle_params *p);
+
+#define CIRCLE_KERNEL(name, fmt, aa, blend4) \
+static void name(const struct circle_params *p) \
+{ \
+    struct GBitmap *bmp = p->bmp; \
+    const uint32_t colors = p->colors; \
+    const uint8_t color = colors >> 24; \
+    fmt##_SETUP(); \
+    const int32_t half = (1 << (FIXED_SHIFT - 1)); \
+    const int32_t cx = p->cx; \
+    const int32_t cy = p->cy; \
+    const int32_t r2 = p->r2; \
+    const int32_t rs = p->rs; \
+    /* rs is only negative for circles below a quarter pixel, whose */ \
+    /* bands are empty */ \
+    const struct recip rcp = recip_init(aa && rs > 0 ? rs : 1); \
+    (void)colors; \
+    DRAW_CIRCLE_LINES(p->y0, p->y1, fmt, aa, blend4); \
+}
+
+CIRCLE_KERNEL(circle_dark, BYTE, 1, blend4(x4, col4, cov, 4))
+CIRCLE_KERNEL(circle_dark_outline, BYTE, 1, blend4(x4, col4, cov, 3))
+CIRCLE_KERNEL(circle_light, BYTE, 1, blend_inv4(x4, col4, cov, 4))
+CIRCLE_KERNEL(circle_light_outline, BYTE, 1, blend_inv4(x4, col4, cov, 3))
+CIRCLE_KERNEL(circle_bg, BYTE, 1,
+              select_aa4(x4, (colors & 0xFF) * 0x01010101u,
+                         ((colors >> 8) & 0xFF) * 0x01010101u,
+                         ((colors >> 16) & 0xFF) * 0x01010101u, col4, cov))
+CIRCLE_KERNEL(circle_solid, BYTE, 0, x4)
+
+// the bg kernels of 1 bit rows dither the color over the background as well
+CIRCLE_KERNEL(circle_bits, BIT, 1, RIM_NONE)
+CIRCLE_KERNEL(circle_bits_black_rim, BIT, 1, RIM_BLACK)
+CIRCLE_KERNEL(circle_bits_white_rim, BIT, 1, RIM_WHITE)
+CIRCLE_KERNEL(circle_bits_solid, BIT, 0, RIM_NONE)
+
+static void setup_circle(struct circle_params *p, int32_t cx, int32_t cy,
+                         int32_t r)
 {
     int32_t half = (1 << (FIXED_SHIFT - 1));
-    int smooth = 2;
-    int32_t fs2 = fixed(smooth)/2;
-    int od = outline ? 3 : 4;
+    int32_t fs2 = fixed(AA_SMOOTH)/2;
 
     int32_t r0 = r - fs2;
     int32_t r1 = r + fs2 - half;
     int32_t r2 = r1 * r1;
-    int32_t rs = r2 - r0 * r0;
 
-    int y0 = fixedfloor(cy - r1);
-    int y1 = fixedceil(cy + r1);
+    p->cx = cx;
+    p->cy = cy;
+    p->r2 = r2;
+    p->rs = r2 - r0 * r0;
+    p->y0 = fixedfloor(cy - r1);
+    p->y1 = fixedceil(cy + r1);
+}
+
+void draw_circle(struct GBitmap *bmp, uint8_t color, int32_t cx, int32_t cy,
+                 int32_t r, bool outline, bool dark_bg)
+{
+    static const circle_kernel kernels[2][2] = {
+        { circle_light, circle_light_outline },
+        { circle_dark, circle_dark_outline },
+    };
+    static const circle_kernel bit_kernels[2][2] = {
+        { circle_bits, circle_bits_white_rim },
+        { circle_bits, circle_bits_black_rim },
+    };
 
-    if (dark_bg)
-        DRAW_CIRCLE_LINES(y0, y1, blend);
+    struct circle_params p = {
+        .bmp = bmp,
+        .colors = (uint32_t)color << 24,
+    };
+    setup_circle(&p, cx, cy, r);
+    STATS_PRIM(PRIM_CIRCLE);
+
+    if (is_1bit(bmp))
+        (antialias ? bit_kernels[dark_bg][outline] : circle_bits_solid)(&p);
+    else if (antialias)
+        kernels[dark_bg][outline](&p);
+    else
+        circle_solid(&p);
+}
+
+void draw_bg_circle(struct GBitmap *bmp, uint32_t colors, int32_t cx,
+                    int32_t cy, int32_t r)
+{
+    struct circle_params p = {
+        .bmp = bmp,
+        .colors = colors,
+    };
+    setup_circle(&p, cx, cy, r);
+    STATS_PRIM(PRIM_CIRCLE);
+
+    if (is_1bit(bmp))
+        (antialias ? circle_bits : circle_bits_solid)(&p);
+    else if (antialias)
+        circle_bg(&p);
     else
-        DRAW_CIRCLE_LINES(y0, y1, blend_inv);
+        circle_solid(&p);
 }
 
 static inline void update_scanline(struct scanline *line, int x0, int x1)
@@ -192,393 +644,555 @@ static inline void update_scanline(struct scanline *line, int x0, int x1)
     if (line->end < end) line->end = end;
 }
 
-#define AA_STEP(mask, left, blend) \
-    int32_t d0 = d0s >> dshift; \
-    int32_t d1 = d1s >> dshift; \
-    d0s -= dys; \
-    d1s += dxs; \
-    int32_t d = mask ? mini(d0 < 0 ? w + d0 : w - d0, \
-                            (mask == 1) || ((mask == 3) && d1 < fs2) ? \
-                                d1 - s0 : s1 - d1) : \
-                       left ? w - d0 : w + d0; \
-\
-    int a = (d * 4 / smooth) >> FIXED_SHIFT; \
-    if (a <= 0) continue; \
-    if (a < 4) line[x] = blend
-
-#define DRAW_RECT_LINES(y0, y1, mask, blend) ({\
-\
-    for (int y = y0; y < y1; ++y) \
+
+/*
+ * Convex polygons are scan converted from a table of their edges. Each edge
+ * has an inward normal (nx, ny) of length fixed(256) and
+ * v = nx * fx + ny * fy + c is the distance of the pixel center (fx, fy)
+ * from the edge, shifted by dshift and offset by half of the AA width. The
+ * coverage of a pixel is the one of its nearest edge, for rects this is the
+ * same as taking the nearest side or end cap.
+ */
+
+#define POLY_MAX_EDGES 6
+
+// floor(m / den) of a threshold crossing, stepped from row to row
+struct poly_dda
+{
+    int32_t q, r, dq, dr, den;
+};
+
+struct poly_edge
+{
+    int32_t nx, ny, c;
+    // x where v reaches t_out, t_in is at most inset pixels further in
+    struct poly_dda out;
+    int32_t inset;
+};
+
+struct poly_params
+{
+    struct GBitmap *bmp;
+    struct scanline *scanlines;
+    uint32_t colors;
+    int n, nl, nr;
+    int y0, y1;
+    struct poly_edge edges[POLY_MAX_EDGES];
+};
+
+typedef void (*poly_kernel)(struct poly_params *p);
+
+// only for b > 0
+static inline int32_t floordiv(int32_t a, int32_t b)
+{
+    int32_t q = a / b;
+    return q * b > a ? q - 1 : q;
+}
+
+static inline void dda_init(struct poly_dda *d, int32_t m, int32_t dm,
+                            int32_t den)
+{
+    d->den = den;
+    d->q = floordiv(m, den);
+    d->r = m - d->q * den;
+    d->dq = floordiv(dm, den);
+    d->dr = dm - d->dq * den;
+}
+
+// without a branch, the carry is hard to predict
+static inline void dda_step(struct poly_dda *d)
+{
+    int32_t r = d->r + d->dr - d->den;
+    int32_t borrow = r >> 31;
+    d->r = r + (d->den & borrow);
+    d->q += d->dq + 1 + borrow;
+}
+
+static inline int32_t min_dist(const int32_t *v, int k, int32_t m)
+{
+    for (int i = 0; i < k; ++i) m = mini(m, v[i]);
+    return m;
+}
+
+static inline void step_dist(int32_t *v, const int32_t *dv, int k)
+{
+    for (int i = 0; i < k; ++i) v[i] += dv[i];
+}
+
+#define POLY_COVERAGE(v) \
+    mini((((v) >> dshift) * 4 / AA_SMOOTH) >> FIXED_SHIFT, 4)
+
+#define BYTE_POLY_LOOP(xend, dist, advance, blend4) ({\
+    for (; x < xend; ++x) \
+    { \
+        cov |= (uint32_t)POLY_COVERAGE(dist) << ((x & 0x3) * 8); \
+        advance; \
+        if ((x & 0x3) == 0x3) AA_STORE(blend4); \
+    } \
+    if (cov) AA_STORE(blend4); \
+})
+
+#define BIT_POLY_LOOP(xend, dist, advance, rim_color) ({\
+    for (; x < xend; ++x) \
+    { \
+        BIT_ADD(POLY_COVERAGE(dist), rim_color); \
+        advance; \
+        if ((x & 0x1F) == 0x1F) BIT_STORE(rim_color); \
+    } \
+    if (cov | rim) BIT_STORE(rim_color); \
+})
+
+// band up to xend, only edges not fully covering it take part
+#define POLY_BAND(xend, fmt, blend4) ({\
+    int32_t v[POLY_MAX_EDGES], dv[POLY_MAX_EDGES]; \
+    int k = 0; \
+    for (int j = 0; j < n; ++j) \
     { \
+        if (j < nl ? in[j] <= x : j < nl + nr ? in[j] >= xend : !in[j]) \
+            continue; \
+        v[k] = e[j].nx * (fixed(x) + half) + e[j].ny * fy + e[j].c; \
+        dv[k++] = fixed(e[j].nx); \
+    } \
+    fmt##_PENDING(); \
+    if (k == 1) \
+    { \
+        int32_t va = v[0]; \
+        const int32_t da = dv[0]; \
+        fmt##_POLY_LOOP(xend, va, va += da, blend4); \
+    } \
+    else if (k == 2) \
+    { \
+        int32_t va = v[0], vb = v[1]; \
+        const int32_t da = dv[0], db = dv[1]; \
+        fmt##_POLY_LOOP(xend, mini(va, vb), (va += da, vb += db), blend4); \
+    } \
+    else \
+        fmt##_POLY_LOOP(xend, min_dist(v, k, t_in), step_dist(v, dv, k), \
+                        blend4); \
+})
+
+#define DRAW_POLY_LINES(fmt, aa, blend4) ({\
+    for (; y < clip_bottom(p->y1); ++y) \
+    { \
+        STATS_ROW(); \
         int32_t fy = fixed(y) + half; \
-        int32_t fydx = (fy - py) * dx; \
-        int32_t fydy = (fy - py) * dy; \
- \
-        int32_t x0, x1, x2; \
-        if (dy > 0) \
+        /* first or last fully covered x, whether an edge cuts the row */ \
+        int32_t in[POLY_MAX_EDGES]; \
+        int x0 = INT16_MIN, x1 = INT16_MAX; \
+        int xi0 = INT16_MIN, xi1 = INT16_MAX; \
+        int i = 0; \
+        for (; i < nl; ++i) \
+        { \
+            x0 = maxi(x0, -e[i].out.q); \
+            in[i] = e[i].inset - e[i].out.q; \
+            xi0 = maxi(xi0, in[i]); \
+            dda_step(&e[i].out); \
+        } \
+        for (; i < nl + nr; ++i) \
         { \
-            x0 = (fydx - ws0) / dy; \
-            x1 = (fydx + ws1) / dy; \
-            x2 = (fydx + ws0) / dy; \
+            x1 = mini(x1, e[i].out.q + 1); \
+            in[i] = e[i].out.q + 1 - e[i].inset; \
+            xi1 = mini(xi1, in[i]); \
+            dda_step(&e[i].out); \
+        } \
+        for (; i < n; ++i) \
+        { \
+            int32_t v = e[i].ny * fy + e[i].c; \
+            in[i] = v < t_in; \
+            if (v < t_out) x1 = x0; \
+            else if (v < t_in) xi1 = xi0; \
+        } \
  \
-            if (dx != 0 && mask) \
-            { \
-                int32_t x3 = (((dx > 0 ? t0 : t1) << dshift) - fydy) / dx; \
-                int32_t x4 = (((dx > 0 ? t1 : t0) << dshift) - fydy) / dx; \
-                int32_t x5 = \
-                    ((dx < 0 ? s0 << dshift : s1 << dshift) - fydy) / dx; \
-                if (x3 > x0) x0 = x3; \
-                if (x4 < x1) x1 = x4; \
-                if (x5 < x2) x2 = x5; \
-            } \
+        GBitmapDataRowInfo row = get_clipped_row(bmp, y); \
+        uint8_t *line = row.data; \
+        int xmin = row.min_x; \
+        int xmax = row.max_x + 1; \
+        fmt##_ROW(y); \
+        x0 = maxi(x0, xmin); \
+        x1 = mini(x1, xmax); \
+        if (x0 >= x1) continue; \
+        if (xi0 >= xi1) \
+        { \
+            xi0 = x1; \
+            xi1 = x1; \
         } \
         else \
         { \
-            x0 = t0; \
-            x1 = t1; \
-            x2 = s1; \
+            xi0 = mini(maxi(xi0, x0), x1); \
+            xi1 = mini(maxi(xi1, xi0), x1); \
         } \
  \
-        uint8_t *line = gbitmap_get_data_row_info(bmp, (unsigned)y).data; \
-        int ix0 = fixedfloor(x0 + px); \
-        int ix1 = fixedfloor(x1 + px); \
-        int ix2 = fixedfloor(x2 + px); \
-        int32_t dys = dy << FIXED_SHIFT; \
-        int32_t dxs = dx << FIXED_SHIFT; \
+        update_scanline(scanlines + y, x0, x1); \
  \
-        update_scanline(scanlines + y, ix0, ix2); \
+        int x = x0; \
+        if (aa && x < xi0) POLY_BAND(xi0, fmt, blend4); \
  \
-        int32_t d0s = fydx + pxdy - (fixed(ix0) + half) * dy; \
-        int32_t d1s = (fixed(ix0) + half) * dx - pxdx + fydy; \
-        int x; \
-        for (x = ix0; x < ix1; ++x) \
-        { \
-            AA_STEP(mask, true, blend); \
-            else break; \
-        } \
+        STATS_SOLID(y, x, xi1); \
+        fmt##_FILL(xi1); \
  \
-        for (; x < ix1; ++x) \
-            line[x] = color; \
- \
-        d0s = fydx + pxdy - (fixed(x) + half) * dy; \
-        d1s = (fixed(x) + half) * dx - pxdx + fydy; \
-        for (; x < ix2; ++x) \
-        { \
-            AA_STEP(mask, false, blend); \
-            else line[x] = color; \
-        } \
+        if (aa && x < x1) POLY_BAND(x1, fmt, blend4); \
     } \
 })
 
-#define DRAW_RECT(y0, y1, y2, y3, blend) ({\
-    if (y1 < y2) \
-    { \
-        DRAW_RECT_LINES(y0, y1, 0x1, blend); \
-        DRAW_RECT_LINES(y1, y2, 0, blend); \
-        DRAW_RECT_LINES(y2, y3, 0x2, blend); \
-    } \
-    else \
-    { \
-        DRAW_RECT_LINES(y0, y3, 0x3, blend); \
-    } \
-})
-
-void draw_bg_rect(struct GBitmap *bmp, struct scanline *scanlines,
-                  uint32_t colors, int32_t px, int32_t py,
-                  int32_t dx, int32_t dy, int32_t len, int32_t w)
+/*
+ * Edges limiting the span on the left (nx > 0) come first, then the ones on
+ * the right (nx < 0) and the horizontal ones last.
+ */
+static void sort_edges(struct poly_params *p)
 {
-    uint8_t color = colors >> 24;
+    struct poly_edge e[POLY_MAX_EDGES];
+    int n = 0;
+
+    for (int i = 0; i < p->n; ++i)
+        if (p->edges[i].nx > 0) e[n++] = p->edges[i];
+    p->nl = n;
+    for (int i = 0; i < p->n; ++i)
+        if (p->edges[i].nx < 0) e[n++] = p->edges[i];
+    p->nr = n - p->nl;
+    for (int i = 0; i < p->n; ++i)
+        if (p->edges[i].nx == 0) e[n++] = p->edges[i];
+
+    memcpy(p->edges, e, sizeof(e));
+}
 
-    // length of (dx, dy) is assumed to be fixed(256)
-    const int dshift = FIXED_SHIFT + 8;
+// crossings of the left and right edges are stepped from row y on
+static void init_edges(const struct poly_params *p, struct poly_edge *e,
+                       int y, int32_t t_out, int32_t t_in)
+{
+    const int32_t half = (1 << (FIXED_SHIFT - 1));
 
-    // (dx, dy) shall point downwards or right
-    if (dy < 0 || (dy == 0 && dx < 0))
+    memcpy(e, p->edges, sizeof(p->edges));
+    for (int i = 0; i < p->nl + p->nr; ++i)
     {
-        px += (dx * len) >> dshift;
-        py += (dy * len) >> dshift;
-        dx = -dx;
-        dy = -dy;
+        int32_t m = e[i].ny * (fixed(y) + half) + e[i].c + e[i].nx * half;
+        int32_t den = fixed(e[i].nx < 0 ? -e[i].nx : e[i].nx);
+        dda_init(&e[i].out, m - t_out, fixed(e[i].ny), den);
+        e[i].inset = (t_in - t_out + den - 1) / den;
     }
+}
 
-    int32_t half = (1 << (FIXED_SHIFT - 1));
-
-    int smooth = 2;
-    int32_t fs2 = fixed(smooth)/2;
-    int32_t wi = w - fs2;
-    w += fs2;
-    int32_t s0 = -fs2;
-    int32_t s1 = len + fs2;
-    int32_t t0 = dx < 0 ? s0 + 2 * fs2 : s0;
-    int32_t t1 = dx < 0 ? s1 : s1 - 2 * fs2;
+#define POLY_LINES_KERNEL(name, edges, left, right, fmt, aa, blend4) \
+static void name(const struct poly_params *p) \
+{ \
+    struct GBitmap *bmp = p->bmp; \
+    struct scanline *scanlines = p->scanlines; \
+    const uint32_t colors = p->colors; \
+    const uint8_t color = colors >> 24; \
+    fmt##_SETUP(); \
+    const int dshift = FIXED_SHIFT + 8; \
+    const int32_t half = (1 << (FIXED_SHIFT - 1)); \
+    /* v where coverage reaches 1 and 4, or 2 for both without AA, */ \
+    /* the bands between them are empty then */ \
+    const int32_t t_out = (fixed(AA_SMOOTH) / (aa ? 4 : 2)) << dshift; \
+    const int32_t t_in = aa ? fixed(AA_SMOOTH) << dshift : t_out; \
+    const int n = edges; \
+    const int nl = left; \
+    const int nr = right; \
+    int y = clip_top(p->y0); \
+    struct poly_edge e[POLY_MAX_EDGES]; \
+    init_edges(p, e, y, t_out, t_in); \
+    (void)colors; \
+    DRAW_POLY_LINES(fmt, aa, blend4); \
+}
 
-    int32_t wdx = ((dx < 0 ? -dx : dx) * w) >> dshift;
-    int32_t sdy = (fs2 * dy) >> dshift;
-    int y0 = fixedfloor(py - wdx - sdy);
-    int y1 = fixedceil(py + wdx + sdy);
-    int y2 = fixedfloor(py + ((dy * len) >> dshift) - wdx - sdy);
-    int y3 = fixedceil(py + ((dy * len) >> dshift) + wdx + sdy);
+// quads with two left and two right edges, like all rects which are not
+// axis aligned, get their own kernel with the edge loops unrolled
+#define POLY_KERNEL(name, fmt, aa, blend4) \
+POLY_LINES_KERNEL(name##_quad, 4, 2, 2, fmt, aa, blend4) \
+POLY_LINES_KERNEL(name##_any, p->n, p->nl, p->nr, fmt, aa, blend4) \
+static void name(struct poly_params *p) \
+{ \
+    sort_edges(p); \
+    if (p->n == 4 && p->nl == 2 && p->nr == 2) \
+        name##_quad(p); \
+    else \
+        name##_any(p); \
+}
 
-    int32_t ws0 = w << dshift;
-    int32_t ws1 = wi << dshift;
-    int32_t pxdy = px * dy;
-    int32_t pxdx = px * dx;
+POLY_KERNEL(poly_dark, BYTE, 1, blend4(x4, col4, cov, 4))
+POLY_KERNEL(poly_dark_outline, BYTE, 1, blend4(x4, col4, cov, 3))
+POLY_KERNEL(poly_light, BYTE, 1, blend_inv4(x4, col4, cov, 4))
+POLY_KERNEL(poly_light_outline, BYTE, 1, blend_inv4(x4, col4, cov, 3))
+POLY_KERNEL(poly_bg, BYTE, 1,
+            select_aa4(x4, (colors & 0xFF) * 0x01010101u,
+                       ((colors >> 8) & 0xFF) * 0x01010101u,
+                       ((colors >> 16) & 0xFF) * 0x01010101u, col4, cov))
+POLY_KERNEL(poly_solid, BYTE, 0, x4)
+
+POLY_KERNEL(poly_bits, BIT, 1, RIM_NONE)
+POLY_KERNEL(poly_bits_black_rim, BIT, 1, RIM_BLACK)
+POLY_KERNEL(poly_bits_white_rim, BIT, 1, RIM_WHITE)
+POLY_KERNEL(poly_bits_solid, BIT, 0, RIM_NONE)
+
+static const poly_kernel poly_kernels[2][2] = {
+    { poly_light, poly_light_outline },
+    { poly_dark, poly_dark_outline },
+};
+
+static const poly_kernel poly_bit_kernels[2][2] = {
+    { poly_bits, poly_bits_white_rim },
+    { poly_bits, poly_bits_black_rim },
+};
+
+static inline poly_kernel get_poly_kernel(struct GBitmap *bmp, bool outline,
+                                          bool dark_bg)
+{
+    if (is_1bit(bmp))
+        return antialias ? poly_bit_kernels[dark_bg][outline] : poly_bits_solid;
+    return antialias ? poly_kernels[dark_bg][outline] : poly_solid;
+}
 
-    DRAW_RECT(y0, y1, y2, y3, (uint8_t)(colors >> (8 * (a - 1))));
+// colors holds the blends of the background to the color at coverage 1 to 4
+static inline poly_kernel get_poly_bg_kernel(struct GBitmap *bmp)
+{
+    if (is_1bit(bmp))
+        return antialias ? poly_bits : poly_bits_solid;
+    return antialias ? poly_bg : poly_solid;
 }
 
+// edge with inward normal (nx, ny), (ox, oy) lies d inside of it
+static void add_edge(struct poly_params *p, int32_t nx, int32_t ny,
+                     int32_t ox, int32_t oy, int32_t d)
+{
+    const int dshift = FIXED_SHIFT + 8;
+    struct poly_edge *e = p->edges + p->n++;
+    e->nx = nx;
+    e->ny = ny;
+    e->c = ((d + fixed(AA_SMOOTH)/2) << dshift) - nx * ox - ny * oy;
+}
 
-void draw_rect(struct GBitmap *bmp, struct scanline *scanlines,
-               uint8_t color, int32_t px, int32_t py,
-               int32_t dx, int32_t dy, int32_t len, int32_t w,
-               bool outline, bool dark_bg)
+static void setup_rect(struct poly_params *p, int32_t px, int32_t py,
+                       int32_t dx, int32_t dy, int32_t len, int32_t w)
 {
     // length of (dx, dy) is assumed to be fixed(256)
     const int dshift = FIXED_SHIFT + 8;
+    int32_t fs2 = fixed(AA_SMOOTH)/2;
+
+    add_edge(p, dy, -dx, px, py, w);
+    add_edge(p, -dy, dx, px, py, w);
+    add_edge(p, dx, dy, px, py, 0);
+    add_edge(p, -dx, -dy, px, py, len);
+
+    int32_t ey = (dy * len) >> dshift;
+    int32_t wdx = ((dx < 0 ? -dx : dx) * (w + fs2)) >> dshift;
+    int32_t sdy = ((dy < 0 ? -dy : dy) * fs2) >> dshift;
+    p->y0 = fixedfloor(py + mini(ey, 0) - wdx - sdy);
+    p->y1 = fixedceil(py + maxi(ey, 0) + wdx + sdy);
+}
+
+static void setup_polygon(struct poly_params *p, const struct point *pts,
+                          int n)
+{
+    if (n > POLY_MAX_EDGES) n = POLY_MAX_EDGES;
 
-    // (dx, dy) shall point downwards or right
-    if (dy < 0 || (dy == 0 && dx < 0))
+    // any point inside tells the inward side of the edges
+    int32_t cx = 0, cy = 0;
+    int32_t ymin = pts[0].y, ymax = pts[0].y;
+    for (int i = 0; i < n; ++i)
     {
-        px += (dx * len) >> dshift;
-        py += (dy * len) >> dshift;
-        dx = -dx;
-        dy = -dy;
+        cx += pts[i].x;
+        cy += pts[i].y;
+        ymin = mini(ymin, pts[i].y);
+        ymax = maxi(ymax, pts[i].y);
     }
+    cx /= n;
+    cy /= n;
 
-    int32_t half = (1 << (FIXED_SHIFT - 1));
+    for (int i = 0; i < n; ++i)
+    {
+        const struct point *a = pts + i;
+        const struct point *b = pts + (i + 1 < n ? i + 1 : 0);
+        int32_t ex = b->x - a->x;
+        int32_t ey = b->y - a->y;
+        int32_t l = sqrti(ex * ex + ey * ey);
+        if (l == 0) continue;
+
+        int32_t nx = -ey * fixed(256) / l;
+        int32_t ny = ex * fixed(256) / l;
+        if (nx * (cx - a->x) + ny * (cy - a->y) < 0)
+        {
+            nx = -nx;
+            ny = -ny;
+        }
+        add_edge(p, nx, ny, a->x, a->y, 0);
+    }
 
-    int od = outline ? 3 : 4;
-    int smooth = 2;
-    int32_t fs2 = fixed(smooth)/2;
-    int32_t wi = w - fs2;
-    w += fs2;
-    int32_t s0 = -fs2;
-    int32_t s1 = len + fs2;
-    int32_t t0 = dx < 0 ? s0 + 2 * fs2 : s0;
-    int32_t t1 = dx < 0 ? s1 : s1 - 2 * fs2;
-
-    int32_t wdx = ((dx < 0 ? -dx : dx) * w) >> dshift;
-    int32_t sdy = (fs2 * dy) >> dshift;
-    int y0 = fixedfloor(py - wdx - sdy);
-    int y1 = fixedceil(py + wdx + sdy);
-    int y2 = fixedfloor(py + ((dy * len) >> dshift) - wdx - sdy);
-    int y3 = fixedceil(py + ((dy * len) >> dshift) + wdx + sdy);
-
-    int32_t ws0 = w << dshift;
-    int32_t ws1 = wi << dshift;
-    int32_t pxdy = px * dy;
-    int32_t pxdx = px * dx;
-
-    if (dark_bg)
-        DRAW_RECT(y0, y1, y2, y3, blend(line[x], color, a, od));
-    else
-        DRAW_RECT(y0, y1, y2, y3, blend_inv(line[x], color, a, od));
+    // sharp corners are cut off where the AA would reach further
+    p->y0 = fixedfloor(ymin - fixed(AA_SMOOTH));
+    p->y1 = fixedceil(ymax + fixed(AA_SMOOTH));
 }
 
-#define DRAW_VSTRIP_LINES(y0, y1, mask, blend) ({\
-\
-    for (int y = y0; y < y1; ++y) \
-    { \
-        int32_t fy = fixed(y) + half; \
-        int32_t fydx = (fy - py) * dx; \
- \
-        int32_t x0 = (fydx - ws0) / dy; \
-        int32_t x1 = (fydx + ws1) / dy; \
-        int32_t x2 = (fydx + ws0) / dy; \
- \
-        uint8_t *line = gbitmap_get_data_row_info(bmp, (unsigned)y).data; \
-        int ix0 = fixedfloor(x0 + px); \
-        int ix1 = fixedfloor(x1 + px); \
-        int ix2 = fixedfloor(x2 + px); \
-        int32_t dys = dy << FIXED_SHIFT; \
-        int32_t dxs = 0; \
- \
-        update_scanline(scanlines + y, ix0, ix2); \
- \
-        int32_t d0s = fydx + pxdy - (fixed(ix0) + half) * dy; \
-        int32_t d1s = (fy - py) << dshift; \
-        int x; \
-        for (x = ix0; x < ix1; ++x) \
-        { \
-            AA_STEP(mask, true, blend); \
-            else break; \
-        } \
- \
-        for (; x < ix1; ++x) \
-            line[x] = color; \
- \
-        d0s = fydx + pxdy - (fixed(x) + half) * dy; \
-        for (; x < ix2; ++x) \
-        { \
-            AA_STEP(mask, false, blend); \
-            else line[x] = color; \
-        } \
-    } \
-})
+void draw_polygon(struct GBitmap *bmp, struct scanline *scanlines,
+                  uint8_t color, const struct point *pts, int n,
+                  bool outline, bool dark_bg)
+{
+    struct poly_params p = {
+        .bmp = bmp,
+        .scanlines = scanlines,
+        .colors = (uint32_t)color << 24,
+    };
+    setup_polygon(&p, pts, n);
+    STATS_PRIM(PRIM_POLYGON);
+    get_poly_kernel(bmp, outline, dark_bg)(&p);
+}
 
-#define DRAW_VSTRIP(blend) ({\
-    if (y1 < y2) \
-    { \
-        DRAW_VSTRIP_LINES(y0, y1, 0x1, blend); \
-        DRAW_VSTRIP_LINES(y1, y2, 0, blend); \
-        DRAW_VSTRIP_LINES(y2, y3, 0x2, blend); \
-    } \
-})
+void draw_bg_polygon(struct GBitmap *bmp, struct scanline *scanlines,
+                     uint32_t colors, const struct point *pts, int n)
+{
+    struct poly_params p = {
+        .bmp = bmp,
+        .scanlines = scanlines,
+        .colors = colors,
+    };
+    setup_polygon(&p, pts, n);
+    STATS_PRIM(PRIM_POLYGON);
+    get_poly_bg_kernel(bmp)(&p);
+}
+
+void draw_bg_rect(struct GBitmap *bmp, struct scanline *scanlines,
+                  uint32_t colors, int32_t px, int32_t py,
+                  int32_t dx, int32_t dy, int32_t len, int32_t w)
+{
+    struct poly_params p = {
+        .bmp = bmp,
+        .scanlines = scanlines,
+        .colors = colors,
+    };
+    setup_rect(&p, px, py, dx, dy, len, w);
+    STATS_PRIM(PRIM_RECT);
+    get_poly_bg_kernel(bmp)(&p);
+}
+
+void draw_rect(struct GBitmap *bmp, struct scanline *scanlines,
+               uint8_t color, int32_t px, int32_t py,
+               int32_t dx, int32_t dy, int32_t len, int32_t w,
+               bool outline, bool dark_bg)
+{
+    struct poly_params p = {
+        .bmp = bmp,
+        .scanlines = scanlines,
+        .colors = (uint32_t)color << 24,
+    };
+    setup_rect(&p, px, py, dx, dy, len, w);
+    STATS_PRIM(PRIM_RECT);
+    get_poly_kernel(bmp, outline, dark_bg)(&p);
+}
 
+// strip with horizontal ends, (px, py) and the end are on the same column
 void draw_vstrip(struct GBitmap *bmp, struct scanline *scanlines,
                  uint32_t colors, int32_t px, int32_t py,
                  int32_t dx, int32_t dy, int32_t len, int32_t w)
 {
-    uint8_t color = colors >> 24;
-
     // length of (dx, dy) is assumed to be fixed(256)
     const int dshift = FIXED_SHIFT + 8;
+    if (dy == 0) return;
 
-    // (dx, dy) shall point downwards or right
-    if (dy < 0 || (dy == 0 && dx < 0))
-    {
-        px += (dx * len) >> dshift;
-        py += (dy * len) >> dshift;
-        dx = -dx;
-        dy = -dy;
-    }
+    struct poly_params p = {
+        .bmp = bmp,
+        .scanlines = scanlines,
+        .colors = colors,
+    };
 
-    int32_t half = (1 << (FIXED_SHIFT - 1));
+    int32_t fs2 = fixed(AA_SMOOTH)/2;
+    int32_t sy = dy > 0 ? fixed(256) : -fixed(256);
+    int32_t ey = (dy * len) >> dshift;
 
-    int smooth = 2;
-    int32_t fs2 = fixed(smooth)/2;
-    int32_t wi = w - fs2;
-    w += fs2;
-    // distances along line where aa starts and ends
-    int32_t s0 = -fs2;
-    int32_t s1 = ((dy * len) >> dshift) + fs2;
-    // y coordinates where line starts and ends
-    int y0 = fixedfloor(py - fs2);
-    int y1 = fixedceil(py + fs2);
-    int y2 = fixedfloor(py + ((dy * len) >> dshift) - fs2);
-    int y3 = fixedceil(py + ((dy * len) >> dshift) + fs2);
-
-    int32_t ws0 = w << dshift;
-    int32_t ws1 = wi << dshift;
-    int32_t pxdy = px * dy;
-
-    DRAW_VSTRIP((uint8_t)(colors >> (8 * (a - 1))));
-}
-
-#define DRAW_HSTRIP_LINES(y0, y1, mask, blend) ({\
-\
-    for (int y = y0; y < y1; ++y) \
-    { \
-        int32_t fy = fixed(y) + half; \
-        int32_t fydx = (fy - py) * dx; \
- \
-        int32_t x0, x1, x2; \
-        if (dy > 0) \
-        { \
-            x0 = (fydx - ws0) / dy; \
-            x1 = (fydx + ws1) / dy; \
-            x2 = (fydx + ws0) / dy; \
- \
-            if (dx != 0 && mask) \
-            { \
-                if (e0 > x0) x0 = e0; \
-                if (e1 < x1) x1 = e1; \
-                if (e2 < x2) x2 = e2; \
-            } \
-        } \
-        else \
-        { \
-            x0 = e0; \
-            x1 = e1; \
-            x2 = e2; \
-        } \
- \
-        uint8_t *line = gbitmap_get_data_row_info(bmp, (unsigned)y).data; \
-        int ix0 = fixedfloor(x0 + px); \
-        int ix1 = fixedfloor(x1 + px); \
-        int ix2 = fixedfloor(x2 + px); \
-        int32_t dys = dy << FIXED_SHIFT; \
-        int32_t dxs = (dx > 0 ? 1 : -1) << (FIXED_SHIFT + dshift); \
- \
-        update_scanline(scanlines + y, ix0, ix2); \
- \
-        int32_t d0s = fydx + pxdy - (fixed(ix0) + half) * dy; \
-        int32_t d1s = (dx > 0 ? (fixed(ix0) + half) - px : px - (fixed(ix0) + half)) << dshift; \
-        int x; \
-        for (x = ix0; x < ix1; ++x) \
-        { \
-            AA_STEP(mask, true, blend); \
-            else break; \
-        } \
- \
-        for (; x < ix1; ++x) \
-            line[x] = color; \
- \
-        d0s = fydx + pxdy - (fixed(x) + half) * dy; \
-        d1s = (dx > 0 ? (fixed(x) + half) - px : px - (fixed(x) + half)) << dshift; \
-        for (; x < ix2; ++x) \
-        { \
-            AA_STEP(mask, false, blend); \
-            else line[x] = color; \
-        } \
-    } \
-})
+    add_edge(&p, dy, -dx, px, py, w);
+    add_edge(&p, -dy, dx, px, py, w);
+    add_edge(&p, 0, sy, px, py, 0);
+    add_edge(&p, 0, -sy, px, py, dy > 0 ? ey : -ey);
 
-#define DRAW_HSTRIP(blend) ({\
-    DRAW_HSTRIP_LINES(y0, y3, 0x3, blend); \
-})
+    p.y0 = fixedfloor(py + mini(ey, 0) - fs2);
+    p.y1 = fixedceil(py + maxi(ey, 0) + fs2);
+    STATS_PRIM(PRIM_STRIP);
+    get_poly_bg_kernel(bmp)(&p);
+}
 
+// strip with vertical ends
 void draw_hstrip(struct GBitmap *bmp, struct scanline *scanlines,
                  uint32_t colors, int32_t px, int32_t py,
                  int32_t dx, int32_t dy, int32_t len, int32_t w)
 {
-    uint8_t color = colors >> 24;
-
     // length of (dx, dy) is assumed to be fixed(256)
     const int dshift = FIXED_SHIFT + 8;
+    if (dx == 0) return;
 
-    // (dx, dy) shall point downwards or right
-    if (dy < 0 || (dy == 0 && dx < 0))
-    {
-        px += (dx * len) >> dshift;
-        py += (dy * len) >> dshift;
-        dx = -dx;
-        dy = -dy;
-    }
-
-    int32_t half = (1 << (FIXED_SHIFT - 1));
-
-    int smooth = 2;
-    int32_t fs2 = fixed(smooth)/2;
-    int32_t wi = w - fs2;
-    w += fs2;
-    int32_t s0 = -fs2;
-    int32_t s1 = (((dx > 0 ? dx : -dx) * len) >> dshift) + fs2;
-    int32_t e0 = dx > 0 ? s0 : -s1;
-    int32_t e1 = (dx > 0 ? s1 : -s0) - 2 * fs2;
-    int32_t e2 = dx > 0 ? s1 : -s0;
-
-    int32_t ws0 = w << dshift;
-    int32_t ws1 = wi << dshift;
+    struct poly_params p = {
+        .bmp = bmp,
+        .scanlines = scanlines,
+        .colors = colors,
+    };
 
-    int32_t sdy = ((dx > 0 ? ws0 : -ws0) - dy * fs2) / dx;
-    int y0 = fixedfloor(py - sdy);
-    int y3 = fixedceil(py + ((dy * len) >> dshift) + sdy);
+    int32_t fs2 = fixed(AA_SMOOTH)/2;
+    int32_t adx = dx < 0 ? -dx : dx;
+    int32_t sx = dx > 0 ? fixed(256) : -fixed(256);
+    int32_t ey = (dy * len) >> dshift;
+    // vertical extent of half of the strip
+    int32_t wy = ((w + fs2) << dshift) / adx;
+
+    add_edge(&p, dy, -dx, px, py, w);
+    add_edge(&p, -dy, dx, px, py, w);
+    add_edge(&p, sx, 0, px, py, 0);
+    add_edge(&p, -sx, 0, px, py, (adx * len) >> dshift);
+
+    p.y0 = fixedfloor(py + mini(ey, 0) - wy - fs2);
+    p.y1 = fixedceil(py + maxi(ey, 0) + wy + fs2);
+    STATS_PRIM(PRIM_STRIP);
+    get_poly_bg_kernel(bmp)(&p);
+}
 
-    int32_t pxdy = px * dy;
+// 1 bit resources only have the colors 0 and 3
+static void draw_2bit_bmp_bits(struct GBitmap *bmp, struct bmpset *set, int n,
+                               int x, int y, uint32_t colors)
+{
+    int y0 = set->h * n;
+    bool src_bits = gbitmap_get_format(set->bmp) == GBitmapFormat1Bit;
+    int levels[4];
+    for (int a = 0; a < 4; ++a)
+        levels[a] = gray_level(colors >> (a * 8));
 
-    DRAW_HSTRIP((uint8_t)(colors >> (8 * (a - 1))));
+    int y1 = clip_bottom(y + set->h);
+    for (int py = clip_top(y); py < y1; ++py)
+    {
+        GBitmapDataRowInfo row = get_clipped_row(bmp, py);
+        int c0 = maxi(row.min_x - x, 0);
+        int c1 = mini(row.max_x + 1 - x, set->w);
+        if (c0 >= c1) continue;
+        uint8_t *src = gbitmap_get_data_row_info(set->bmp, py - y + y0).data;
+        const uint32_t *dither = dither_bits[py & 1];
+        STATS_ROW();
+        STATS_SOLID(py, x + c0, x + c1);
+        for (int c = c0; c < c1; ++c)
+        {
+            uint8_t a = src_bits ? ((src[c >> 3] >> (c & 0x7)) & 0x1) * 3
+                                 : (src[c / 4] >> (6 - (c & 0x3) * 2)) & 0x3;
+            put_bit(row.data, x + c, dither[levels[a]]);
+        }
+    }
 }
 
 void draw_2bit_bmp(struct GBitmap *bmp, struct bmpset *set, int n,
                    int x, int y, uint32_t colors)
 {
     int y0 = set->h * n;
-    for (int r = 0; r < set->h; ++r)
+    STATS_PRIM(PRIM_BITMAP);
+    if (is_1bit(bmp))
+    {
+        draw_2bit_bmp_bits(bmp, set, n, x, y, colors);
+        return;
+    }
+    int y1 = clip_bottom(y + set->h);
+    for (int py = clip_top(y); py < y1; ++py)
     {
-        uint8_t *src = gbitmap_get_data_row_info(set->bmp, r + y0).data;
-        uint8_t *dst = gbitmap_get_data_row_info(bmp, r + y).data;
-        for (int c = 0; c < set->w; ++c)
+        GBitmapDataRowInfo row = get_clipped_row(bmp, py);
+        int c0 = maxi(row.min_x - x, 0);
+        int c1 = mini(row.max_x + 1 - x, set->w);
+        if (c0 >= c1) continue;
+        uint8_t *src = gbitmap_get_data_row_info(set->bmp, py - y + y0).data;
+        uint8_t *dst = row.data;
+        STATS_ROW();
+        STATS_SOLID(py, x + c0, x + c1);
+        for (int c = c0; c < c1; ++c)
         {
             int sb = c / 4;
             int sr = c & 0x3;
@@ -594,11 +1208,24 @@ void draw_2bit_bmp_aligned(struct GBitmap *bmp, struct bmpset *set, int n,
     int ix = x >> 2;
     int iw = (set->w + 3) >> 2;
     int y0 = set->h * n;
-    for (int r = 0; r < set->h; ++r)
+    STATS_PRIM(PRIM_BITMAP);
+    if (is_1bit(bmp))
+    {
+        draw_2bit_bmp_bits(bmp, set, n, x, y, colors);
+        return;
+    }
+    int y1 = clip_bottom(y + set->h);
+    for (int py = clip_top(y); py < y1; ++py)
     {
-        uint8_t *src = gbitmap_get_data_row_info(set->bmp, r + y0).data;
-        uint32_t *dst = (uint32_t *)gbitmap_get_data_row_info(bmp, r + y).data;
-        for (int c = 0; c < iw; ++c)
+        GBitmapDataRowInfo row = get_clipped_row(bmp, py);
+        int x0 = maxi(row.min_x, ix * 4);
+        int x1 = mini(row.max_x + 1, (ix + iw) * 4);
+        if (x0 >= x1) continue;
+        uint8_t *src = gbitmap_get_data_row_info(set->bmp, py - y + y0).data;
+        uint32_t *dst = (uint32_t *)row.data;
+        STATS_ROW();
+        STATS_SOLID(py, x0, x1);
+        for (int c = (x0 >> 2) - ix; c <= ((x1 - 1) >> 2) - ix; ++c)
         {
             uint8_t s = src[c];
             uint32_t word = 0;
@@ -607,7 +1234,53 @@ void draw_2bit_bmp_aligned(struct GBitmap *bmp, struct bmpset *set, int n,
                 uint32_t a = (s >> (6 - i * 2)) & 3;
                 word |= (uint32_t)((colors >> (a * 8)) & 0xFF) << (i * 8);
             }
-            dst[ix + c] = word;
+            // words cut by the visible part are written a pixel at a time
+            int px = (ix + c) * 4;
+            if (px >= x0 && px + 4 <= x1)
+                dst[ix + c] = word;
+            else
+                for (int i = 0; i < 4; ++i)
+                    if (px + i >= x0 && px + i < x1)
+                        row.data[px + i] = word >> (i * 8);
+        }
+    }
+}
+
+void draw_bitmap(struct GBitmap *bmp, struct GBitmap *src, int x, int y)
+{
+    GRect bounds = gbitmap_get_bounds(src);
+    bool bits = is_1bit(bmp);
+    STATS_PRIM(PRIM_BITMAP);
+    int y1 = clip_bottom(y + bounds.size.h);
+    for (int py = clip_top(y); py < y1; ++py)
+    {
+        GBitmapDataRowInfo row = get_clipped_row(bmp, py);
+        int x0 = x < row.min_x ? row.min_x : x;
+        int x1 = x + bounds.size.w;
+        if (x1 > row.max_x + 1) x1 = row.max_x + 1;
+        if (x0 >= x1) continue;
+        uint8_t *line = gbitmap_get_data_row_info(src, py - y).data;
+        STATS_ROW();
+        STATS_SOLID(py, x0, x1);
+        if (! bits)
+        {
+            memcpy(row.data + x0, line + (x0 - x), x1 - x0);
+            continue;
+        }
+        // one destination word at a time, from up to two source words
+        const uint32_t *words = (const uint32_t *)line;
+        for (int px = x0; px < x1; )
+        {
+            int sx = px - x;
+            int n = 32 - (px & 0x1F);
+            if (n > x1 - px) n = x1 - px;
+            uint32_t w = words[sx >> 5] >> (sx & 0x1F);
+            if ((sx & 0x1F) + n > 32)
+                w |= words[(sx >> 5) + 1] << (32 - (sx & 0x1F));
+            uint32_t m = (n == 32 ? ~0u : (1u << n) - 1) << (px & 0x1F);
+            uint32_t *dst = (uint32_t *)row.data + (px >> 5);
+            *dst = (*dst & ~m) | ((w << (px & 0x1F)) & m);
+            px += n;
         }
     }
 }
@@ -626,16 +1299,27 @@ void draw_digit(struct GBitmap *bmp, uint8_t color, int x, int y, int n)
     int s = x >> 2;
     int n3 = n * 3;
     uint32_t col4 = (color << 24) | (color << 16) | (color << 8) | color;
+    bool bits = is_1bit(bmp);
 
     for (int r = 0; r < 5; ++r)
     {
         int k = r < 1 || 2 < r ? h : h - 1;
         for (int i = 0; i < k; ++i, ++y)
         {
+            if (row_clipped(y))
+                continue;
             uint32_t mask = (digitmask[r] >> n3) & 0x7;
-            uint32_t *line = (uint32_t *)gbitmap_get_data_row_info(bmp, y).data;
+            GBitmapDataRowInfo row = get_clipped_row(bmp, y);
             for (int j = 0; mask; ++j, mask >>= 1)
-                if (mask & 1) line[s + j] = col4;
+            {
+                if (! (mask & 1))
+                    continue;
+                int px = (s + j) * 4;
+                if (bits || px < row.min_x || px + 4 > row.max_x + 1)
+                    fill_clipped(row, bits, y, px, px + 4, color);
+                else
+                    ((uint32_t *)row.data)[s + j] = col4;
+            }
         }
     }
 }
@@ -653,18 +1337,21 @@ void draw_small_digit(struct GBitmap *bmp, uint8_t color, int x, int y, int n)
     int w = 2;
     int h = 2;
     int n3 = n * 3;
+    bool bits = is_1bit(bmp);
 
     for (int r = 0; r < 5; ++r)
     {
         int k = r != 2 ? h : h - 1;
         for (int i = 0; i < k; ++i, ++y)
         {
+            if (row_clipped(y))
+                continue;
             uint32_t mask = (digitmask[r] >> n3) & 0x7;
-            uint8_t *line = gbitmap_get_data_row_info(bmp, y).data;
+            GBitmapDataRowInfo row = get_clipped_row(bmp, y);
             for (int j = 0; mask; ++j, mask >>= 1)
                 if (mask & 1)
-                    for (int b = 0; b < w; ++b)
-                        line[x + j * w + b] = color;
+                    fill_clipped(row, bits, y, x + j * w, x + j * w + w,
+                                 color);
         }
     }
 }
@@ -705,14 +1392,17 @@ void draw_disconnected(struct GBitmap *bmp, struct scanline *scanlines,
 
     int x = cx - w / 2;
     int y = cy - h / 2;
+    bool bits = is_1bit(bmp);
 
     for (int r = 0; r < h; ++r, ++y)
     {
+        if (row_clipped(y))
+            continue;
         uint16_t mask = bitmask[r];
-        uint8_t *line = gbitmap_get_data_row_info(bmp, y).data;
+        GBitmapDataRowInfo row = get_clipped_row(bmp, y);
         for (int j = 0; mask; ++j, mask >>= 1)
             if (mask & 0x1)
-                line[x + j] = color;
+                fill_clipped(row, bits, y, x + j, x + j + 1, color);
 
         update_scanline(scanlines + y, x, x + w);
     }
@@ -729,40 +1419,32 @@ void draw_battery(struct GBitmap *bmp, struct scanline *scanlines,
     int y = cy - h / 2;
 
     int l = (level * (w - b * 3 - 2) + 50)/ 100;
-    uint8_t *line;
+    bool bits = is_1bit(bmp);
 
-    for (int j = 0; j < b; ++j, ++y)
+    for (int j = 0; j < h; ++j, ++y)
     {
-        line = gbitmap_get_data_row_info(bmp, y).data;
-        for (int i = 0; i < w - b; ++i)
-            line[i + x] = color;
-        update_scanline(scanlines + y, x, x + w);
-    }
-
-    for (int j = b; j < h - b; ++j, ++y)
-    {
-        line = gbitmap_get_data_row_info(bmp, y).data;
-        for (int i = 0; i < b; ++i) line[x + i] = color;
-        int k = b;
-        if (j > b && j < h - b - 1)
+        if (row_clipped(y))
+            continue;
+        GBitmapDataRowInfo row = get_clipped_row(bmp, y);
+        if (j < b || j >= h - b)
+            fill_clipped(row, bits, y, x, x + w - b, color);
+        else
         {
-            for (int i = 0; i < l; ++i)
-                line[x + b + 1 + i] = color;
-            k += b;
-        }
+            fill_clipped(row, bits, y, x, x + b, color);
+            int k = b;
+            if (j > b && j < h - b - 1)
+            {
+                fill_clipped(row, bits, y, x + b + 1, x + b + 1 + l, color);
+                k += b;
+            }
 
-        for (int i = 0; i < k; ++i) line[x + w - 2 * b + i] = color;
+            fill_clipped(row, bits, y, x + w - 2 * b, x + w - 2 * b + k,
+                         color);
+        }
 
         update_scanline(scanlines + y, x, x + w);
     }
 
-    for (int j = 0; j < b; ++j, ++y)
-    {
-        line = gbitmap_get_data_row_info(bmp, y).data;
-        for (int i = 0; i < w - b; ++i)
-            line[i + x] = color;
+    if (! row_clipped(y))
         update_scanline(scanlines + y, x, x + w);
-    }
-
-    update_scanline(scanlines + y, x, x + w);
 }
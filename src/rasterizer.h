@@ -26,8 +26,30 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "fixedmath.h"
+
 #define FIXED_SHIFT 4
 
+// count pixels and rows written by the primitives, see get_raster_stats()
+#ifndef RASTER_STATS
+#define RASTER_STATS 0
+#endif
+// also build the 1 bit kernels on color platforms, so BENCH can time them in
+// an offscreen bitmap
+#ifndef RASTER_1BIT_ON_COLOR
+#define RASTER_1BIT_ON_COLOR 0
+#endif
+
+// pixel formats the primitives are built for, 8 bit on the color platforms
+// and 1 bit on the black and white ones
+#ifdef PBL_BW
+#define RASTER_8BIT 0
+#define RASTER_1BIT 1
+#else
+#define RASTER_8BIT 1
+#define RASTER_1BIT RASTER_1BIT_ON_COLOR
+#endif
+
 #define DIGIT_HEIGHT 13
 #define DIGIT_WIDTH 12
 
@@ -54,13 +76,66 @@ struct bmpset
     int w, h;
 };
 
+// fixed point coordinates
+struct point
+{
+    int32_t x, y;
+};
+
+#if RASTER_STATS
+enum
+{
+    PRIM_RECT,
+    PRIM_POLYGON,
+    PRIM_STRIP,
+    PRIM_CIRCLE,
+    PRIM_BITMAP,
+    // spans cleared or restored by the caller
+    PRIM_CLEAR,
+    NUM_PRIMS
+};
+
+struct raster_stats
+{
+    uint32_t calls, rows;
+    uint32_t solid, blended, cleared;
+};
+
+// counters of each primitive type since the last reset
+const struct raster_stats *get_raster_stats(void);
+void reset_raster_stats(void);
+void count_cleared(int y, int x0, int x1);
+// optional per pixel write counts, saturating at 255
+void set_raster_overdraw(uint8_t *counts, int stride);
+#endif
+
+#if RASTER_8BIT && RASTER_1BIT
+// whether bmp has 1 bit per pixel, the primitives draw in either format
+bool is_1bit(struct GBitmap *bmp);
+#else
+static inline bool is_1bit(struct GBitmap *bmp)
+{
+    (void)bmp;
+    return RASTER_1BIT;
+}
+#endif
+
+// primitives below only draw inside of this rect and the visible part of rows
+void set_clip_rect(int x0, int y0, int x1, int y1);
+// rects, polygons and circles are drawn without AA while disabled
+void set_antialias(bool aa);
+
 void draw_2bit_bmp(struct GBitmap *bmp, struct bmpset *set, int n,
                    int x, int y, uint32_t colors);
 void draw_2bit_bmp_aligned(struct GBitmap *bmp, struct bmpset *set, int n,
                            int x, int y, uint32_t colors);
+// copies src of the same format to x, y of bmp
+void draw_bitmap(struct GBitmap *bmp, struct GBitmap *src, int x, int y);
 void draw_digit(struct GBitmap *bmp, uint8_t color, int x, int y, int n);
 void draw_small_digit(struct GBitmap *bmp, uint8_t color, int x, int y, int n);
 void draw_box(struct GBitmap *bmp, uint8_t color, int x, int y, int w, int h);
+// fills [x0, x1) of row y
+void draw_span(struct GBitmap *bmp, uint8_t color, int y, int x0, int x1);
 void draw_rect(struct GBitmap *bmp, struct scanline *scanlines,
                uint8_t color, int32_t px, int32_t py,
                int32_t dx, int32_t dy, int32_t len, int32_t w,
@@ -74,16 +149,22 @@ void draw_vstrip(struct GBitmap *bmp, struct scanline *scanlines,
 void draw_hstrip(struct GBitmap *bmp, struct scanline *scanlines,
                  uint32_t colors, int32_t px, int32_t py,
                  int32_t dx, int32_t dy, int32_t len, int32_t w);
+// convex polygon with up to 6 points, in either winding order
+void draw_polygon(struct GBitmap *bmp, struct scanline *scanlines,
+                  uint8_t color, const struct point *pts, int n,
+                  bool outline, bool dark_bg);
+void draw_bg_polygon(struct GBitmap *bmp, struct scanline *scanlines,
+                     uint32_t colors, const struct point *pts, int n);
 void draw_circle(struct GBitmap *bmp, uint8_t color, int32_t cx, int32_t cy,
                  int32_t r, bool outline, bool dark_bg);
+void draw_bg_circle(struct GBitmap *bmp, uint32_t colors, int32_t cx,
+                    int32_t cy, int32_t r);
 
 void draw_disconnected(struct GBitmap *bmp, struct scanline *scanlines,
                        uint8_t color, int cx, int cy);
 void draw_battery(struct GBitmap *bmp, struct scanline *scanlines,
                   uint8_t color, int cx, int cy, uint8_t level);
 
-int32_t sqrti(int32_t i);
-
 static inline int32_t fixed(int i)
 {
    return (int32_t)i << FIXED_SHIFT;
@@ -106,4 +187,80 @@ static inline uint8_t blend(uint32_t x, uint32_t y, int a, int d)
     return (uint8_t)(((b & 0xCC) + (c & 0x330)) >> 2);
 }
 
+/*
+ * Word versions of blend() and blend_inv() for four pixels at once. Each byte
+ * of cov holds the coverage of the corresponding pixel: 0 keeps x, 1 to 3
+ * blend and 4 sets y.
+ */
+
+// bytes of a, where cov >= k, otherwise bytes of b
+static inline uint32_t select_ge4(uint32_t cov, uint32_t k,
+                                  uint32_t a, uint32_t b)
+{
+#if defined(__ARM_FEATURE_DSP) || defined(__ARM_ARCH_7EM__)
+    uint32_t r, t;
+    __asm__("usub8 %1, %2, %3\n\t"
+            "sel %0, %4, %5"
+            : "=r"(r), "=&r"(t)
+            : "r"(cov), "r"(k), "r"(a), "r"(b)
+            : "cc");
+    return r;
+#else
+    // coverage is at most 4, so no byte can carry into the next
+    uint32_t m = ((cov + 0x80808080 - k) >> 7) & 0x01010101;
+    return b ^ ((a ^ b) & (m * 0xFF));
+#endif
+}
+
+static inline uint32_t select_aa4(uint32_t x, uint32_t c1, uint32_t c2,
+                                  uint32_t c3, uint32_t c4, uint32_t cov)
+{
+    x = select_ge4(cov, 0x01010101, c1, x);
+    x = select_ge4(cov, 0x02020202, c2, x);
+    x = select_ge4(cov, 0x03030303, c3, x);
+    return select_ge4(cov, 0x04040404, c4, x);
+}
+
+/*
+ * Channels are spread into 4 bit lanes, which can hold x * (d - a) + y * a.
+ * Each step from a to a + 1 adds y - x per lane, the intermediate borrows
+ * cancel out since every final lane is in range again.
+ */
+#define BLEND4_RAMP(xl, xh, yl, yh, d, c1, c2, c3) ({\
+    uint32_t dl = yl - xl; \
+    uint32_t dh = yh - xh; \
+    uint32_t l = xl * (d - 1) + yl; \
+    uint32_t h = xh * (d - 1) + yh; \
+    c1 = ((l >> 2) & 0x33333333) | (h & 0xCCCCCCCC); \
+    l += dl; \
+    h += dh; \
+    c2 = ((l >> 2) & 0x33333333) | (h & 0xCCCCCCCC); \
+    l += dl; \
+    h += dh; \
+    c3 = ((l >> 2) & 0x33333333) | (h & 0xCCCCCCCC); \
+})
+
+static inline uint32_t blend4(uint32_t x, uint32_t y, uint32_t cov, int d)
+{
+    uint32_t xl = x & 0x33333333;
+    uint32_t xh = (x >> 2) & 0x33333333;
+    uint32_t yl = y & 0x33333333;
+    uint32_t yh = ((y >> 2) | 0x30303030) & 0x33333333;
+    uint32_t c1, c2, c3;
+    BLEND4_RAMP(xl, xh, yl, yh, d, c1, c2, c3);
+    return select_aa4(x, c1, c2, c3, y, cov);
+}
+
+static inline uint32_t blend_inv4(uint32_t x, uint32_t y, uint32_t cov, int d)
+{
+    uint32_t xl = ~x & 0x33333333;
+    uint32_t xh = (~x >> 2) & 0x33333333;
+    uint32_t yl = ~y & 0x33333333;
+    uint32_t yh = (~y >> 2) & 0x33333333;
+    uint32_t c1, c2, c3;
+    BLEND4_RAMP(xl, xh, yl, yh, d, c1, c2, c3);
+    return select_aa4(x, ~c1 | 0xC0C0C0C0, ~c2 | 0xC0C0C0C0,
+                      ~c3 | 0xC0C0C0C0, y, cov);
+}
+
 #endif
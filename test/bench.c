@@ -0,0 +1,262 @@
+/*
+ * Frame times of the watchface on each platform of this build, with the
+ * settings of each preset. Like the on-watch BENCH, every minute of the day
+ * and every second of one minute are drawn, and the frames per second and
+ * the pixels changed per frame are reported. The p99 of each platform and
+ * preset is compared to its baseline, the exit status is 1 if one is more
+ * than BENCH_THRESHOLD percent and BENCH_SLACK_US above.
+ *
+ *   bench [-w] baseline
+ *
+ * -w records the baseline instead, an existing one is only raised. Times are
+ * those of the host, so the baseline has to come from the machine comparing
+ * against it and is not part of the tree, make bench-baseline takes the
+ * largest p99 of a few runs. Without a baseline nothing is compared.
+ */
+
+#include "host.h"
+
+#include <unistd.h>
+
+#define BENCH_FRAMES (24 * 60 + 60)
+// the day is walked this often, each frame counts with its fastest time, so
+// interruptions of the host do not
+#define BENCH_ROUNDS 5
+#define BENCH_THRESHOLD 20
+// but at least this much, frames of the host are short enough to be skewed by
+// the load of the machine
+#define BENCH_SLACK_US 10
+
+#define MAX_BASELINES 64
+
+// 13.4 E, 52.5 N in units of TRIG_MAX_ANGLE, for sun times
+#define BENCH_LOCATION "longitude=2439,latitude=9557"
+
+static const struct preset
+{
+    const char *name;
+    const char *settings;
+    // disconnected, with the battery shown at any charge
+    bool status;
+    // obstructed by the quick view
+    bool peek;
+} presets[] = {
+    { "config", NULL },
+    { "seconds", "showsec=0,sectimeout=0" },
+    { "outline", "outline=0" },
+    { "hourbelowmin", "hourbelowmin=1" },
+    { "colorflip", "colorflip=1;" BENCH_LOCATION },
+    { "fonts", "dayfont=0,dialfont=0" },
+    { "dialnumbers", "hournumshow=0,minnumshow=1" },
+    { "status", "batwarn=100", true },
+    { "peek", NULL, false, true },
+};
+
+struct result
+{
+    uint32_t p50, p99;
+    // frames per second at the fastest time of each frame
+    uint32_t fps;
+    // pixels changed per frame
+    uint32_t pixels;
+    uint32_t oob;
+    bool done;
+};
+
+static const struct preset *preset;
+static struct result *result;
+
+static int compare_us(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// messages of a preset are separated by ;
+static void push_settings(const char *settings)
+{
+    char *copy = strdup(settings), *save;
+    for (char *s = strtok_r(copy, ";", &save); s;
+         s = strtok_r(NULL, ";", &save))
+        host_push(s);
+    free(copy);
+}
+
+static void run(void)
+{
+    if (preset->settings)
+        push_settings(preset->settings);
+    if (preset->status)
+    {
+        host_battery(50, false);
+        host_connection(false);
+    }
+    if (preset->peek)
+        host_obstruct(host_platform->obstruction);
+    // lets the debounce of the connection pass
+    host_advance(5000);
+    host_frame();
+
+    static uint32_t us[BENCH_FRAMES];
+    memset(us, 0xFF, sizeof(us));
+    uint64_t pixels = 0;
+    uint32_t frames = 0;
+    for (int round = 0; round < BENCH_ROUNDS; ++round)
+    {
+        // the first frame of a round changes what the last one drew
+        if (round == BENCH_ROUNDS - 1)
+        {
+            pixels = host_stats->pixels;
+            frames = host_stats->frames;
+        }
+        for (int f = 0; f < BENCH_FRAMES; ++f)
+        {
+            int m = f < 24 * 60 ? f : 10 * 60 + 8;
+            int s = f < 24 * 60 ? 0 : f - 24 * 60;
+            TimeUnits units = SECOND_UNIT;
+            if (s == 0) units |= MINUTE_UNIT;
+            if (s == 0 && m % 60 == 0) units |= HOUR_UNIT;
+            host_tick(HOST_EPOCH + 86400 + m * 60 + s, units);
+            int t = host_frame();
+            if (t >= 0 && (uint32_t)t < us[f])
+                us[f] = t;
+        }
+    }
+    frames = host_stats->frames - frames;
+    result->pixels = frames ? (host_stats->pixels - pixels) / frames : 0;
+    // ticks which change nothing, like seconds while they are hidden, are
+    // not drawn
+    qsort(us, BENCH_FRAMES, sizeof(us[0]), compare_us);
+    int n = 0;
+    uint64_t total = 0;
+    while (n < BENCH_FRAMES && us[n] != UINT32_MAX)
+        total += us[n++];
+    result->fps = total ? n * 1000000ull / total : 0;
+    result->p50 = us[n * 50 / 100];
+    result->p99 = us[n * 99 / 100];
+    result->oob = host_stats->oob;
+    result->done = true;
+}
+
+static struct baseline
+{
+    char platform[16], preset[16];
+    uint32_t p99;
+} baselines[MAX_BASELINES];
+
+static int num_baselines;
+
+static struct baseline *find_baseline(const char *platform,
+                                      const char *name, bool add)
+{
+    for (int i = 0; i < num_baselines; ++i)
+        if (! strcmp(baselines[i].platform, platform) &&
+            ! strcmp(baselines[i].preset, name))
+            return &baselines[i];
+    if (! add || num_baselines == MAX_BASELINES)
+        return NULL;
+    struct baseline *b = &baselines[num_baselines++];
+    snprintf(b->platform, sizeof(b->platform), "%s", platform);
+    snprintf(b->preset, sizeof(b->preset), "%s", name);
+    return b;
+}
+
+static void read_baselines(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (! f)
+        return;
+    char line[128];
+    while (fgets(line, sizeof(line), f))
+    {
+        char platform[16], name[16];
+        unsigned p99;
+        if (line[0] != '#' &&
+            sscanf(line, "%15s %15s %u", platform, name, &p99) == 3)
+            find_baseline(platform, name, true)->p99 = p99;
+    }
+    fclose(f);
+}
+
+static bool write_baselines(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (! f)
+        return false;
+    fprintf(f, "# p99 frame time in us of each platform and preset, "
+            "written by make bench-baseline\n");
+    for (int i = 0; i < num_baselines; ++i)
+        fprintf(f, "%s %s %u\n", baselines[i].platform, baselines[i].preset,
+                (unsigned)baselines[i].p99);
+    return fclose(f) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    bool write = false;
+    while ((opt = getopt(argc, argv, "w")) != -1)
+    {
+        if (opt != 'w')
+            return 2;
+        write = true;
+    }
+    if (optind != argc - 1)
+    {
+        fprintf(stderr, "usage: %s [-w] baseline\n", argv[0]);
+        return 2;
+    }
+    const char *path = argv[optind];
+    read_baselines(path);
+
+    result = host_shared(sizeof(*result));
+    bool failed = false;
+    for (int i = 0; i < host_num_platforms; ++i)
+    {
+        const struct host_platform *p = &host_platforms[i];
+        if (! host_built_for(p))
+            continue;
+        for (size_t j = 0; j < ARRAY_LENGTH(presets); ++j)
+        {
+            preset = &presets[j];
+            if (preset->peek && ! p->obstruction)
+                continue;
+            memset(result, 0, sizeof(*result));
+            if (host_launch(p, run) != 0 || ! result->done)
+            {
+                printf("%-8s %-13s crashed\n", p->name, preset->name);
+                failed = true;
+                continue;
+            }
+
+            struct baseline *b = find_baseline(p->name, preset->name, write);
+            printf("%-8s %-13s %6u fps  %5u px  p50 %5u us  p99 %5u us",
+                   p->name, preset->name, (unsigned)result->fps,
+                   (unsigned)result->pixels, (unsigned)result->p50,
+                   (unsigned)result->p99);
+            if (write && result->p99 > b->p99)
+                b->p99 = result->p99;
+            else if (b && result->p99 > b->p99 + BENCH_SLACK_US &&
+                     result->p99 * 100 > b->p99 * (100 + BENCH_THRESHOLD))
+            {
+                printf("  over baseline of %u us", (unsigned)b->p99);
+                failed = true;
+            }
+            else if (! b)
+                printf("  no baseline");
+            if (result->oob)
+            {
+                printf("  %u bytes written off screen", (unsigned)result->oob);
+                failed = true;
+            }
+            printf("\n");
+        }
+    }
+
+    if (write && ! write_baselines(path))
+    {
+        perror(path);
+        return 2;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Checks blend4(), blend_inv4() and select_ge4() against the scalar blend()
+ * and blend_inv() for every pair of colors, every coverage and both divisors,
+ * in each of the four bytes of a word.
+ *
+ * The header picks the USUB8 and SEL path on the watch and the SWAR one on the
+ * host. Both are checked here: the DSP path as a model of the two
+ * instructions, and on an ARM build with DSP also the asm of the header
+ * against that model.
+ */
+
+#include "rasterizer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int failures;
+
+#define CHECK(cond, ...) ({\
+    if (! (cond)) \
+    { \
+        if (++failures <= 10) \
+        { \
+            printf("%s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+        } \
+    } \
+})
+
+// usub8 sets the GE flag of each byte which does not borrow, cov >= k, and
+// sel takes those bytes from a
+static uint32_t select_ge4_dsp(uint32_t cov, uint32_t k, uint32_t a,
+                               uint32_t b)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < 32; i += 8)
+    {
+        bool ge = ((cov >> i) & 0xFF) >= ((k >> i) & 0xFF);
+        r |= ((ge ? a : b) >> i & 0xFF) << i;
+    }
+    return r;
+}
+
+static uint32_t select_aa4_dsp(uint32_t x, uint32_t c1, uint32_t c2,
+                               uint32_t c3, uint32_t c4, uint32_t cov)
+{
+    x = select_ge4_dsp(cov, 0x01010101, c1, x);
+    x = select_ge4_dsp(cov, 0x02020202, c2, x);
+    x = select_ge4_dsp(cov, 0x03030303, c3, x);
+    return select_ge4_dsp(cov, 0x04040404, c4, x);
+}
+
+// blend4() and blend_inv4() with the selects of the DSP path
+static uint32_t blend4_dsp(uint32_t x, uint32_t y, uint32_t cov, int d)
+{
+    uint32_t xl = x & 0x33333333;
+    uint32_t xh = (x >> 2) & 0x33333333;
+    uint32_t yl = y & 0x33333333;
+    uint32_t yh = ((y >> 2) | 0x30303030) & 0x33333333;
+    uint32_t c1, c2, c3;
+    BLEND4_RAMP(xl, xh, yl, yh, d, c1, c2, c3);
+    return select_aa4_dsp(x, c1, c2, c3, y, cov);
+}
+
+static uint32_t blend_inv4_dsp(uint32_t x, uint32_t y, uint32_t cov, int d)
+{
+    uint32_t xl = ~x & 0x33333333;
+    uint32_t xh = (~x >> 2) & 0x33333333;
+    uint32_t yl = ~y & 0x33333333;
+    uint32_t yh = (~y >> 2) & 0x33333333;
+    uint32_t c1, c2, c3;
+    BLEND4_RAMP(xl, xh, yl, yh, d, c1, c2, c3);
+    return select_aa4_dsp(x, ~c1 | 0xC0C0C0C0, ~c2 | 0xC0C0C0C0,
+                          ~c3 | 0xC0C0C0C0, y, cov);
+}
+
+// what the word versions promise per pixel: 0 keeps x, 4 sets y
+static uint8_t blend_ref(uint8_t x, uint8_t y, int a, int d, bool inv)
+{
+    if (a == 0) return x;
+    if (a == 4) return y;
+    return inv ? blend_inv(x, y, a, d) : blend(x, y, a, d);
+}
+
+static void test_select(void)
+{
+    srand(1);
+    for (uint32_t cov = 0; cov < 5 * 5 * 5 * 5; ++cov)
+    {
+        uint32_t c = cov % 5 | (cov / 5 % 5) << 8 | (cov / 25 % 5) << 16 |
+            (cov / 125) << 24;
+        for (uint32_t k = 1; k <= 4; ++k)
+            for (int i = 0; i < 16; ++i)
+            {
+                uint32_t a = (uint32_t)rand() << 16 ^ rand();
+                uint32_t b = (uint32_t)rand() << 16 ^ rand();
+                uint32_t ref = select_ge4_dsp(c, k * 0x01010101, a, b);
+                CHECK(select_ge4(c, k * 0x01010101, a, b) == ref,
+                      "select_ge4(%08x, %u)", (unsigned)c, (unsigned)k);
+            }
+    }
+}
+
+static void test_blend(bool inv)
+{
+    // the other bytes of the word run through different pixels, so carries
+    // between bytes would show
+    for (int byte = 0; byte < 4; ++byte)
+        for (int d = 3; d <= 4; ++d)
+            for (int x = 0; x < 64; ++x)
+                for (int y = 0; y < 64; ++y)
+                    for (int a = 0; a <= d; ++a)
+                    {
+                        uint8_t xs[4], ys[4];
+                        int as[4];
+                        uint32_t x4 = 0, y4 = 0, cov = 0;
+                        for (int k = 0; k < 4; ++k)
+                        {
+                            int j = k == byte ? 0 : k + 1;
+                            xs[k] = 0xC0 | ((x + j * 21) & 0x3F);
+                            ys[k] = 0xC0 | ((y + j * 37) & 0x3F);
+                            as[k] = k == byte ? a : (a + j) % (d + 1);
+                            x4 |= (uint32_t)xs[k] << (k * 8);
+                            y4 |= (uint32_t)ys[k] << (k * 8);
+                            cov |= (uint32_t)as[k] << (k * 8);
+                        }
+                        uint32_t swar = inv ? blend_inv4(x4, y4, cov, d) :
+                            blend4(x4, y4, cov, d);
+                        uint32_t dsp = inv ? blend_inv4_dsp(x4, y4, cov, d) :
+                            blend4_dsp(x4, y4, cov, d);
+                        for (int k = 0; k < 4; ++k)
+                        {
+                            uint8_t ref = blend_ref(xs[k], ys[k], as[k], d,
+                                                    inv);
+                            CHECK((uint8_t)(swar >> (k * 8)) == ref &&
+                                  (uint8_t)(dsp >> (k * 8)) == ref,
+                                  "%s(%02x, %02x, %d, %d) = %02x / %02x, "
+                                  "not %02x", inv ? "blend_inv4" : "blend4",
+                                  xs[k], ys[k], as[k], d,
+                                  (uint8_t)(swar >> (k * 8)),
+                                  (uint8_t)(dsp >> (k * 8)), ref);
+                        }
+                    }
+}
+
+int main(void)
+{
+    test_select();
+    test_blend(false);
+    test_blend(true);
+    if (failures)
+        printf("blend: %d failures\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Pushes the whole config page twice, as Clay sends it on every save. The
+ * second push changes nothing, so it must neither mark the window dirty, nor
+ * write persist storage, nor draw a frame. A changed setting must do all
+ * three, which shows the counters work.
+ */
+
+#include "host.h"
+
+static int *failures;
+
+#define CHECK(cond, ...) ({\
+    if (! (cond)) \
+    { \
+        ++*failures; \
+        printf("%-8s ", host_platform->name); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+})
+
+struct counts
+{
+    uint32_t dirty, persist_writes;
+};
+
+static struct counts counts(void)
+{
+    return (struct counts){ host_stats->dirty, host_stats->persist_writes };
+}
+
+static void run(void)
+{
+    host_push(HOST_CLAY_SETTINGS);
+    host_frame();
+
+    struct counts before = counts();
+    host_push(HOST_CLAY_SETTINGS);
+    struct counts after = counts();
+    CHECK(after.dirty == before.dirty, "unchanged config marked dirty");
+    CHECK(after.persist_writes == before.persist_writes,
+          "unchanged config wrote %u keys",
+          (unsigned)(after.persist_writes - before.persist_writes));
+    CHECK(host_frame() < 0, "unchanged config drew a frame");
+
+    host_push("outline=0");
+    after = counts();
+    CHECK(after.dirty > before.dirty, "changed config not marked dirty");
+    CHECK(after.persist_writes > before.persist_writes,
+          "changed config not saved");
+    CHECK(host_frame() >= 0, "changed config not drawn");
+}
+
+int main(void)
+{
+    failures = host_shared(sizeof(*failures));
+    for (int i = 0; i < host_num_platforms; ++i)
+    {
+        const struct host_platform *p = &host_platforms[i];
+        if (! host_built_for(p))
+            continue;
+        host_persist_clear();
+        if (host_launch(p, run) != 0)
+        {
+            printf("%-8s crashed\n", p->name);
+            ++*failures;
+        }
+    }
+    return *failures != 0;
+}
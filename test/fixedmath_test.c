@@ -0,0 +1,199 @@
+/*
+ * Checks the fixed point math against exact results:
+ *
+ * - sqrti() for every input in [0, 2^31), and its speed against the bit by
+ *   bit loop it replaced
+ * - recip_div() for the numerators and divisors of the circle kernels, and
+ *   for samples up to 2^30
+ * - atan2i() within ATAN2_MAX_ERROR of atan2
+ */
+
+#include "fixedmath.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// of 0x10000 per turn
+#define ATAN2_MAX_ERROR 2
+
+// the largest circle of the watchface is the dial of emery, 16 fixed point
+// units per pixel
+#define MAX_RADIUS (200 * 16)
+// AA_SMOOTH and FIXED_SHIFT of the rasterizer
+#define SMOOTH_HALF 16
+#define HALF 8
+
+static int failures;
+
+#define CHECK(cond, ...) ({\
+    if (! (cond)) \
+    { \
+        if (++failures <= 10) \
+        { \
+            printf("%s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+        } \
+    } \
+})
+
+// the sqrti before the lookup table
+static int32_t sqrti_loop(int32_t i)
+{
+    int32_t r = 0;
+    int32_t n = 1 << 30;
+
+    if (i <= 0) return 0;
+    while (n > i) n /= 4;
+
+    while (n != 0)
+    {
+        int32_t k = n + r;
+        if (k <= i)
+        {
+            i -= k;
+            r = r / 2 + n;
+        }
+        else
+            r /= 2;
+        n /= 4;
+    }
+    return r;
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void test_sqrti(void)
+{
+    for (int64_t i = 0; i < (int64_t)1 << 31; ++i)
+    {
+        int64_t r = sqrti((int32_t)i);
+        CHECK(r * r <= i && (r + 1) * (r + 1) > i,
+              "sqrti(%lld) = %lld", (long long)i, (long long)r);
+    }
+    CHECK(sqrti(-1) == 0, "sqrti(-1) = %d", (int)sqrti(-1));
+}
+
+// inputs spread over the whole range, as the kernels use both small and
+// large squares
+static void time_sqrti(void)
+{
+    volatile int32_t sink = 0;
+    const int n = 1 << 24;
+    double t0 = seconds();
+    for (int i = 0; i < n; ++i)
+        sink += sqrti(i * 127);
+    double t1 = seconds();
+    for (int i = 0; i < n; ++i)
+        sink += sqrti_loop(i * 127);
+    double t2 = seconds();
+    (void)sink;
+    printf("sqrti %.1f ns, loop %.1f ns per call\n", (t1 - t0) * 1e9 / n,
+           (t2 - t1) * 1e9 / n);
+    CHECK(t1 - t0 < t2 - t1, "sqrti is slower than the loop");
+}
+
+static int64_t floor_div(int64_t n, int64_t d)
+{
+    return n >= 0 ? n / d : -((-n + d - 1) / d);
+}
+
+// n >= 0 are exact, negative n are only required to stay negative, and are
+// at most one below
+static void check_recip(int32_t n, int32_t d, struct recip r)
+{
+    int64_t q = floor_div(n, d);
+    int32_t got = recip_div(n, r);
+    if (n >= 0)
+        CHECK(got == q, "recip_div(%d, %d) = %d, not %lld", (int)n, (int)d,
+              (int)got, (long long)q);
+    else
+        CHECK(got < 0 && got >= q - 1, "recip_div(%d, %d) = %d, %lld",
+              (int)n, (int)d, (int)got, (long long)q);
+}
+
+// (r2 - ds) * 4 / rs of CIRCLE_COVERAGE for every radius: ds from r2 - rs,
+// the inner edge of the band, to beyond r2, where pixels at the ends of the
+// row are outside of the circle
+static void test_recip_circles(void)
+{
+    for (int32_t r = 1; r <= MAX_RADIUS; ++r)
+    {
+        int32_t r0 = r - SMOOTH_HALF;
+        int32_t r1 = r + SMOOTH_HALF - HALF;
+        int32_t r2 = r1 * r1;
+        int32_t rs = r2 - r0 * r0;
+        if (rs <= 0)
+            continue;
+        struct recip rcp = recip_init(rs);
+        int32_t beyond = 2 * (r1 + 16) * 16 + 256;
+        for (int32_t ds = r2 - rs; ds <= r2 + beyond; ++ds)
+            check_recip((r2 - ds) * 4, rs, rcp);
+    }
+}
+
+static void test_recip_range(void)
+{
+    srand(1);
+    for (int32_t d = 1; d < 1 << 17; ++d)
+    {
+        struct recip rcp = recip_init(d);
+        check_recip(0, d, rcp);
+        check_recip(d - 1, d, rcp);
+        check_recip(d, d, rcp);
+        check_recip((1 << 30) - 1, d, rcp);
+        check_recip(-d, d, rcp);
+        for (int i = 0; i < 64; ++i)
+        {
+            int32_t n = ((rand() & 0x7FFF) << 15 | (rand() & 0x7FFF));
+            check_recip(n, d, rcp);
+            check_recip(-n, d, rcp);
+        }
+    }
+}
+
+static void check_atan2(int32_t y, int32_t x)
+{
+    double a = atan2(y, x) * 0x10000 / (2 * M_PI);
+    if (a < 0) a += 0x10000;
+    double e = fabs(atan2i(y, x) - a);
+    if (e > 0x8000) e = 0x10000 - e;
+    CHECK(e <= ATAN2_MAX_ERROR, "atan2i(%d, %d) = %d, not %.2f", (int)y,
+          (int)x, (int)atan2i(y, x), a);
+}
+
+static void test_atan2i(void)
+{
+    for (int32_t y = -512; y <= 512; ++y)
+        for (int32_t x = -512; x <= 512; ++x)
+            if (x || y)
+                check_atan2(y, x);
+    srand(2);
+    for (int i = 0; i < 1 << 20; ++i)
+    {
+        int32_t y = (rand() & 0xFFFF) << 15 ^ rand();
+        int32_t x = (rand() & 0xFFFF) << 15 ^ rand();
+        check_atan2(rand() & 1 ? y : -y, rand() & 1 ? x : -x);
+    }
+    CHECK(atan2i(0, 0) == 0, "atan2i(0, 0) = %d", (int)atan2i(0, 0));
+}
+
+int main(void)
+{
+    test_sqrti();
+    time_sqrti();
+    test_recip_circles();
+    test_recip_range();
+    test_atan2i();
+    if (failures)
+        printf("fixedmath: %d failures\n", failures);
+    return failures != 0;
+}
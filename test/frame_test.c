@@ -0,0 +1,73 @@
+/*
+ * Hashes the frames of every 7th minute of a day and of the quick view on
+ * each platform of this build, and compares them to the hashes of the frames
+ * as they are meant to look. Changes which should not change a pixel, like
+ * optimizations of the rasterizer, keep them. A change of the look has to
+ * update the table with the hashes printed here.
+ */
+
+#include "host.h"
+
+static int *failures;
+
+static const struct
+{
+    const char *platform;
+    uint64_t hash;
+} expected[] = {
+    { "basalt", 0x5df08785723c6198ull },
+    { "chalk", 0xdf304faf9aec728cull },
+    { "emery", 0xc909871fd1b5062dull },
+    { "aplite", 0xb6df03f478142681ull },
+    { "diorite", 0x3d7ec122896454d3ull },
+};
+
+static void run(void)
+{
+    uint64_t h = 0;
+    host_push("showsec=1,dayfont=0");
+    host_advance(3000);
+    for (int m = 0; m < 24 * 60; m += 7)
+    {
+        host_tick(HOST_EPOCH + 86400 * 3 + m * 60, MINUTE_UNIT | SECOND_UNIT);
+        host_frame();
+        h = h * 31 + host_frame_hash();
+    }
+    host_obstruct(host_platform->obstruction);
+    host_advance(2000);
+    h = h * 31 + host_frame_hash();
+
+    for (size_t i = 0; i < ARRAY_LENGTH(expected); ++i)
+        if (! strcmp(expected[i].platform, host_platform->name) &&
+            expected[i].hash != h)
+        {
+            printf("%-8s frames hash to 0x%016llx, not 0x%016llx\n",
+                   host_platform->name, (unsigned long long)h,
+                   (unsigned long long)expected[i].hash);
+            ++*failures;
+        }
+    if (host_stats->oob)
+    {
+        printf("%-8s %u bytes written off screen\n", host_platform->name,
+               (unsigned)host_stats->oob);
+        ++*failures;
+    }
+}
+
+int main(void)
+{
+    failures = host_shared(sizeof(*failures));
+    for (int i = 0; i < host_num_platforms; ++i)
+    {
+        const struct host_platform *p = &host_platforms[i];
+        if (! host_built_for(p))
+            continue;
+        host_persist_clear();
+        if (host_launch(p, run) != 0)
+        {
+            printf("%-8s crashed\n", p->name);
+            ++*failures;
+        }
+    }
+    return *failures != 0;
+}
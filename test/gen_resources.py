@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+#
+# Generates the headers the Pebble SDK would build from package.json, for the
+# host builds against the stub SDK in sdk/:
+#
+#   message_keys.auto.h   MESSAGE_KEY_* of the messageKeys, and the defaults
+#                         of the config page as settings for host_push()
+#   resource_ids.auto.h   RESOURCE_ID_* in the order of the media
+#   resources.auto.c      the pixels of the grayscale PNG resources
+#
+# usage: gen_resources.py package.json resources_dir config.js out_dir
+
+import json
+import os
+import re
+import struct
+import sys
+import zlib
+
+
+def read_png(path):
+    """Returns width, height and rows of an 8 bit grayscale PNG."""
+    data = open(path, 'rb').read()
+    if data[:8] != b'\x89PNG\r\n\x1a\n':
+        raise ValueError('%s: not a PNG' % path)
+    pos = 8
+    idat = b''
+    header = None
+    while pos < len(data):
+        n, kind = struct.unpack('>I4s', data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + n]
+        if kind == b'IHDR':
+            header = struct.unpack('>IIBBBBB', body)
+        elif kind == b'IDAT':
+            idat += body
+        pos += 12 + n
+    w, h, depth, color, _, _, interlace = header
+    if depth != 8 or color != 0 or interlace:
+        return w, h, None
+
+    raw = zlib.decompress(idat)
+    rows = []
+    prev = bytearray(w)
+    for y in range(h):
+        line = raw[y * (w + 1):(y + 1) * (w + 1)]
+        kind, cur = line[0], bytearray(line[1:])
+        for x in range(w):
+            a = cur[x - 1] if x else 0
+            b = prev[x]
+            c = prev[x - 1] if x else 0
+            if kind == 1:
+                cur[x] = (cur[x] + a) & 0xFF
+            elif kind == 2:
+                cur[x] = (cur[x] + b) & 0xFF
+            elif kind == 3:
+                cur[x] = (cur[x] + (a + b) // 2) & 0xFF
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                pred = a if pa <= pb and pa <= pc else b if pb <= pc else c
+                cur[x] = (cur[x] + pred) & 0xFF
+        rows.append(cur)
+        prev = cur
+    return w, h, rows
+
+
+def clay_settings(path):
+    """Returns the default settings of a Clay config as "key=value,...",
+    radio groups send their value as string."""
+    text = re.sub(r'(?m)^\s*//.*\n', '', open(path).read())
+    config = json.loads(text[text.index('['):text.rindex(']') + 1])
+    settings = {}
+
+    def walk(items):
+        for item in items:
+            walk(item.get('items', []))
+            key = item.get('messageKey')
+            if not key or key in settings:
+                continue
+            value = item['defaultValue']
+            if item['type'] == 'radiogroup':
+                settings[key] = '"%s"' % value
+            else:
+                settings[key] = str(int(value) if isinstance(value, bool)
+                                    else value)
+    walk(config)
+    return ','.join('%s=%s' % kv for kv in settings.items())
+
+
+def main():
+    package, resdir, config, out = sys.argv[1:5]
+    pebble = json.load(open(package))['pebble']
+    os.makedirs(out, exist_ok=True)
+
+    with open(os.path.join(out, 'message_keys.auto.h'), 'w') as f:
+        f.write('#pragma once\n\n')
+        for i, key in enumerate(pebble['messageKeys']):
+            f.write('#define MESSAGE_KEY_%s %d\n' % (key, 10000 + i))
+        f.write('\n#define HOST_MESSAGE_KEYS { \\\n')
+        for key in pebble['messageKeys']:
+            f.write('    "%s", \\\n' % key)
+        f.write('}\n')
+        f.write('\n#define HOST_CLAY_SETTINGS \\\n    "%s"\n' %
+                clay_settings(config).replace('"', '\\"'))
+
+    media = pebble['resources']['media']
+    with open(os.path.join(out, 'resource_ids.auto.h'), 'w') as f:
+        f.write('#pragma once\n\nenum\n{\n    RESOURCE_ID_INVALID,\n')
+        for m in media:
+            f.write('    RESOURCE_ID_%s,\n' % m['name'])
+        f.write('};\n')
+
+    # 8 bit gray as 2 bits per pixel, the first pixel in the highest bits
+    with open(os.path.join(out, 'resources.auto.c'), 'w') as f:
+        f.write('#include "host.h"\n\n')
+        images = []
+        for i, m in enumerate(media):
+            w, h, rows = read_png(os.path.join(resdir, m['file']))
+            if rows is None:
+                images.append('    { "%s", 0, 0, 0, NULL },\n' % m['name'])
+                continue
+            stride = (w + 3) // 4
+            packed = bytearray(stride * h)
+            for y, row in enumerate(rows):
+                for x, v in enumerate(row):
+                    packed[y * stride + x // 4] |= (v >> 6) << (6 - (x & 3) * 2)
+            f.write('static const uint8_t res%d[] = {\n' % i)
+            for j in range(0, len(packed), 16):
+                f.write('    %s,\n' % ', '.join(str(b) for b in packed[j:j + 16]))
+            f.write('};\n\n')
+            images.append('    { "%s", %d, %d, %d, res%d },\n' %
+                          (m['name'], w, h, stride, i))
+        f.write('const struct host_resource host_resources[] = {\n')
+        f.write('    { "INVALID", 0, 0, 0, NULL },\n')
+        f.write(''.join(images))
+        f.write('};\n\nconst int host_num_resources = %d;\n' % (len(media) + 1))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,127 @@
+/*
+ * Times the anti-aliased rect and strip kernels of the rasterizer, as the
+ * hands use them, at 360 angles around the center of an 8 bit bitmap. Each
+ * time is the fastest of KERNEL_RUNS sweeps, per call. Built with
+ * rasterizer.c alone, like raster_oracle, so it also builds against the
+ * rasterizer of an older revision, see make kernel-bench.
+ */
+
+#include "rasterizer.h"
+
+#include <pebble.h>
+
+#include <math.h>
+#include <time.h>
+
+#define KERNEL_RUNS 300
+#define KERNEL_ANGLES 360
+
+#define KERNEL_W 200
+#define KERNEL_H 228
+
+#define KERNEL_COLOR 0xC0
+#define KERNEL_COLORS 0xFFEAD5C0
+
+struct GBitmap
+{
+    uint8_t *data;
+    int16_t w, h;
+};
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap)
+{
+    return GRect(0, 0, bitmap->w, bitmap->h);
+}
+
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap)
+{
+    return GBitmapFormat8Bit;
+}
+
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap,
+                                             uint16_t y)
+{
+    if (y >= bitmap->h)
+        abort();
+    return (GBitmapDataRowInfo){ bitmap->data + y * bitmap->w, 0,
+                                 bitmap->w - 1 };
+}
+
+enum
+{
+    KERNEL_RECT,
+    KERNEL_BG_RECT,
+    KERNEL_STRIP,
+    NUM_KERNELS
+};
+
+static const char *const names[NUM_KERNELS] = { "rect", "bg_rect", "strip" };
+
+static int32_t dxs[KERNEL_ANGLES], dys[KERNEL_ANGLES];
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// a minute hand of the largest display, from the center
+static void sweep(GBitmap *bmp, struct scanline *scanlines, int kernel)
+{
+    int32_t px = fixed(KERNEL_W / 2) + 8, py = fixed(KERNEL_H / 2) + 8;
+    int32_t len = fixed(90), w = fixed(3) / 2;
+    for (int i = 0; i < KERNEL_ANGLES; ++i)
+    {
+        int32_t dx = dxs[i], dy = dys[i];
+        switch (kernel)
+        {
+        case KERNEL_RECT:
+            draw_rect(bmp, scanlines, KERNEL_COLOR, px, py, dx, dy, len, w,
+                      false, false);
+            break;
+        case KERNEL_BG_RECT:
+            draw_bg_rect(bmp, scanlines, KERNEL_COLORS, px, py, dx, dy, len,
+                         w);
+            break;
+        case KERNEL_STRIP:
+            if ((dy < 0 ? -dy : dy) > (dx < 0 ? -dx : dx))
+                draw_vstrip(bmp, scanlines, KERNEL_COLORS, px, py, dx, dy,
+                            len, w);
+            else
+                draw_hstrip(bmp, scanlines, KERNEL_COLORS, px, py, dx, dy,
+                            len, w);
+            break;
+        }
+    }
+}
+
+int main(void)
+{
+    static uint8_t pixels[KERNEL_W * KERNEL_H];
+    static struct scanline scanlines[KERNEL_H];
+    GBitmap bmp = { pixels, KERNEL_W, KERNEL_H };
+
+    set_clip_rect(0, 0, KERNEL_W, KERNEL_H);
+    memset(pixels, 0xFF, sizeof(pixels));
+    for (int i = 0; i < KERNEL_ANGLES; ++i)
+    {
+        double a = (i + 0.25) * 2 * M_PI / KERNEL_ANGLES;
+        dxs[i] = (int32_t)lround(sin(a) * fixed(256));
+        dys[i] = (int32_t)lround(-cos(a) * fixed(256));
+    }
+
+    for (int k = 0; k < NUM_KERNELS; ++k)
+    {
+        uint64_t best = UINT64_MAX;
+        for (int run = 0; run < KERNEL_RUNS; ++run)
+        {
+            uint64_t start = now_ns();
+            sweep(&bmp, scanlines, k);
+            uint64_t t = now_ns() - start;
+            if (t < best) best = t;
+        }
+        printf("%-8s %5d ns\n", names[k], (int)(best / KERNEL_ANGLES));
+    }
+    return 0;
+}
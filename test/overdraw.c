@@ -0,0 +1,116 @@
+/*
+ * Counts the pixels the primitives write over 720 minutes of the hands, with
+ * the RASTER_STATS build of the watchface, on each platform of it. The
+ * counters of each primitive type are summed over the frames, and the most
+ * writes of a pixel in one frame are dumped as a heatmap.
+ *
+ *   overdraw [dir]
+ *
+ * writes dir/overdraw_<platform>.pgm, the brightest pixel is the most
+ * overdrawn one.
+ */
+
+#include "host.h"
+#include "rasterizer.h"
+
+#define OVERDRAW_MINUTES 720
+
+static const char *dir = ".";
+
+static const char *const names[NUM_PRIMS] = {
+    "rect", "polygon", "strip", "circle", "bitmap", "clear",
+};
+
+static bool write_pgm(const char *path, const uint8_t *peak, int w, int h)
+{
+    FILE *f = fopen(path, "wb");
+    if (! f)
+        return false;
+    int max = 1;
+    for (int i = 0; i < w * h; ++i)
+        if (peak[i] > max) max = peak[i];
+    fprintf(f, "P5 %d %d %d\n", w, h, max);
+    fwrite(peak, 1, w * h, f);
+    return fclose(f) == 0;
+}
+
+static void run(void)
+{
+    GRect bounds = gbitmap_get_bounds(host_framebuffer());
+    int w = bounds.size.w, h = bounds.size.h;
+    uint8_t *counts = malloc(w * h);
+    uint8_t *peak = calloc(w * h, 1);
+    struct raster_stats total[NUM_PRIMS];
+    memset(total, 0, sizeof(total));
+    set_raster_overdraw(counts, w);
+
+    for (int m = 1; m <= OVERDRAW_MINUTES; ++m)
+    {
+        memset(counts, 0, w * h);
+        host_tick(HOST_EPOCH + m * 60, SECOND_UNIT | MINUTE_UNIT |
+                  (m % 60 == 0 ? HOUR_UNIT : 0));
+        host_frame();
+
+        const struct raster_stats *stats = get_raster_stats();
+        for (int i = 0; i < NUM_PRIMS; ++i)
+        {
+            total[i].calls += stats[i].calls;
+            total[i].rows += stats[i].rows;
+            total[i].solid += stats[i].solid;
+            total[i].blended += stats[i].blended;
+            total[i].cleared += stats[i].cleared;
+        }
+        for (int i = 0; i < w * h; ++i)
+            if (counts[i] > peak[i]) peak[i] = counts[i];
+    }
+    set_raster_overdraw(NULL, 0);
+
+    uint32_t written = 0;
+    for (int i = 0; i < NUM_PRIMS; ++i)
+    {
+        written += total[i].solid + total[i].blended + total[i].cleared;
+        printf("%-8s %-8s %6d calls %7d rows %8d solid %8d blended "
+               "%8d cleared\n", host_platform->name, names[i],
+               (int)total[i].calls, (int)total[i].rows,
+               (int)total[i].solid, (int)total[i].blended,
+               (int)total[i].cleared);
+    }
+    int max = 0, at = 0;
+    for (int i = 0; i < w * h; ++i)
+        if (peak[i] > max)
+        {
+            max = peak[i];
+            at = i;
+        }
+    printf("%-8s %d pixels per frame, %.2f per pixel, at most %d at %d,%d\n",
+           host_platform->name, (int)(written / OVERDRAW_MINUTES),
+           (double)written / OVERDRAW_MINUTES / (w * h), max, at % w, at / w);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/overdraw_%s.pgm", dir,
+             host_platform->name);
+    if (! write_pgm(path, peak, w, h))
+        perror(path);
+    free(counts);
+    free(peak);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        dir = argv[1];
+    int status = 0;
+    for (int i = 0; i < host_num_platforms; ++i)
+    {
+        const struct host_platform *p = &host_platforms[i];
+        if (! host_built_for(p))
+            continue;
+        host_persist_clear();
+        if (host_launch(p, run) != 0)
+        {
+            printf("%-8s crashed\n", p->name);
+            status = 1;
+        }
+    }
+    return status;
+}
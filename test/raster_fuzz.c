@@ -0,0 +1,260 @@
+/*
+ * Draws every primitive of the rasterizer at random positions, partly or
+ * entirely off screen, with a random clip rect, and checks that no pixel
+ * outside of the clip rect or the visible part of its row was written, on
+ * each platform of this build. Scanlines are checked to only change inside of
+ * the clip rect as well.
+ *
+ *   raster_fuzz [iterations]
+ */
+
+#include "host.h"
+#include "rasterizer.h"
+
+#include <math.h>
+
+#define FUZZ_ITERATIONS 20000
+// how far primitives reach beyond the screen
+#define FUZZ_MARGIN 48
+#define FILL 0x5A
+
+// digits of a font in a bmpset, as the day and dial fonts
+#define GLYPH_W 19
+#define GLYPH_H 25
+
+#define MAX_ERRORS 5
+
+static int iterations = FUZZ_ITERATIONS;
+static int *failures;
+
+static uint32_t seed;
+
+static int rnd(int n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (int)((seed >> 8) % (uint32_t)n);
+}
+
+// in [a, b)
+static int rnd_range(int a, int b)
+{
+    return a + rnd(b - a);
+}
+
+static GBitmap *random_bitmap(int w, int h, GBitmapFormat format)
+{
+    GBitmap *b = gbitmap_create_blank(GSize(w, h), format);
+    uint8_t *data = gbitmap_get_data(b);
+    for (int i = 0; i < gbitmap_get_bytes_per_row(b) * h; ++i)
+        data[i] = rnd(256);
+    return b;
+}
+
+enum
+{
+    FUZZ_DIGIT,
+    FUZZ_SMALL_DIGIT,
+    FUZZ_2BIT_BMP,
+    FUZZ_2BIT_BMP_ALIGNED,
+    FUZZ_BITMAP,
+    FUZZ_DISCONNECTED,
+    FUZZ_BATTERY,
+    FUZZ_BOX,
+    FUZZ_RECT,
+    FUZZ_BG_RECT,
+    FUZZ_STRIP,
+    FUZZ_POLYGON,
+    FUZZ_CIRCLE,
+    FUZZ_BG_CIRCLE,
+    NUM_FUZZ,
+};
+
+static const char *const names[NUM_FUZZ] = {
+    "digit", "small_digit", "2bit_bmp", "2bit_bmp_aligned", "bitmap",
+    "disconnected", "battery", "box", "rect", "bg_rect", "strip", "polygon",
+    "circle", "bg_circle",
+};
+
+static void draw(GBitmap *bmp, struct scanline *scanlines, int prim,
+                 struct bmpset *font, GBitmap *sprite)
+{
+    GRect bounds = gbitmap_get_bounds(bmp);
+    int x = rnd_range(-FUZZ_MARGIN, bounds.size.w + FUZZ_MARGIN);
+    int y = rnd_range(-FUZZ_MARGIN, bounds.size.h + FUZZ_MARGIN);
+    int32_t fx = fixed(x) + rnd(16);
+    int32_t fy = fixed(y) + rnd(16);
+    uint8_t color = 0xC0 | rnd(64);
+    uint32_t colors = 0xC0C0C0C0 | (uint32_t)rnd(1 << 30);
+    // unit vector of a random angle, as the hands use
+    int32_t angle = rnd(TRIG_MAX_ANGLE);
+    int32_t dx = sin_lookup(angle) >> 4;
+    int32_t dy = -cos_lookup(angle) >> 4;
+    int32_t len = rnd(fixed(200));
+    int32_t w = rnd(fixed(12)) + 1;
+
+    switch (prim)
+    {
+    case FUZZ_DIGIT:
+        draw_digit(bmp, color, x, y, rnd(10));
+        break;
+    case FUZZ_SMALL_DIGIT:
+        draw_small_digit(bmp, color, x, y, rnd(10));
+        break;
+    case FUZZ_2BIT_BMP:
+        draw_2bit_bmp(bmp, font, rnd(10), x, y, colors);
+        break;
+    case FUZZ_2BIT_BMP_ALIGNED:
+        draw_2bit_bmp_aligned(bmp, font, rnd(10), x & ~3, y, colors);
+        break;
+    case FUZZ_BITMAP:
+        draw_bitmap(bmp, sprite, x, y);
+        break;
+    case FUZZ_DISCONNECTED:
+        draw_disconnected(bmp, scanlines, color, x, y);
+        break;
+    case FUZZ_BATTERY:
+        draw_battery(bmp, scanlines, color, x, y, rnd(101));
+        break;
+    case FUZZ_BOX:
+        draw_box(bmp, color, x, y, rnd(80), rnd(80));
+        break;
+    case FUZZ_RECT:
+        draw_rect(bmp, scanlines, color, fx, fy, dx, dy, len, w, rnd(2),
+                  rnd(2));
+        break;
+    case FUZZ_BG_RECT:
+        draw_bg_rect(bmp, scanlines, colors, fx, fy, dx, dy, len, w);
+        break;
+    case FUZZ_STRIP:
+        if (rnd(2) && dy)
+            draw_vstrip(bmp, scanlines, colors, fx, fy, dx, dy, len, w);
+        else if (dx)
+            draw_hstrip(bmp, scanlines, colors, fx, fy, dx, dy, len, w);
+        break;
+    case FUZZ_POLYGON:
+    {
+        // convex, the points are in order of their angle around (fx, fy)
+        struct point pts[6];
+        int n = rnd_range(3, 7);
+        int32_t r = rnd(fixed(60)) + fixed(1);
+        int32_t a = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            a += rnd(TRIG_MAX_ANGLE / n) + 1;
+            pts[i].x = fx + (int32_t)((int64_t)sin_lookup(a) * r /
+                                      TRIG_MAX_RATIO);
+            pts[i].y = fy - (int32_t)((int64_t)cos_lookup(a) * r /
+                                      TRIG_MAX_RATIO);
+        }
+        if (rnd(2))
+            draw_polygon(bmp, scanlines, color, pts, n, rnd(2), rnd(2));
+        else
+            draw_bg_polygon(bmp, scanlines, colors, pts, n);
+        break;
+    }
+    case FUZZ_CIRCLE:
+        draw_circle(bmp, color, fx, fy, rnd(fixed(80)) + 1, rnd(2), rnd(2));
+        break;
+    case FUZZ_BG_CIRCLE:
+        draw_bg_circle(bmp, colors, fx, fy, rnd(fixed(80)) + 1);
+        break;
+    }
+}
+
+// written pixels outside of [x0, x1) of a row
+static int check_row(const uint8_t *line, int stride, bool bits, int x0,
+                     int x1)
+{
+    int bad = 0;
+    for (int i = 0; i < stride; ++i)
+    {
+        uint8_t changed = line[i] ^ FILL;
+        if (! changed)
+            continue;
+        for (int k = 0; k < (bits ? 8 : 1); ++k)
+        {
+            int x = bits ? i * 8 + k : i;
+            if ((! bits || changed & (1 << k)) && (x < x0 || x >= x1))
+                ++bad;
+        }
+    }
+    return bad;
+}
+
+static void run(void)
+{
+    GBitmap *bmp = host_framebuffer();
+    GRect bounds = gbitmap_get_bounds(bmp);
+    int h = bounds.size.h;
+    int stride = gbitmap_get_bytes_per_row(bmp);
+    bool bits = is_1bit(bmp);
+    seed = 1;
+
+    struct bmpset font = {
+        random_bitmap(GLYPH_W, GLYPH_H * 10, host_platform->bw_resources ?
+                      GBitmapFormat1Bit : GBitmapFormat2BitPalette),
+        GLYPH_W, GLYPH_H,
+    };
+    GBitmap *sprite = random_bitmap(40, 30, bits ? GBitmapFormat1Bit :
+                                    GBitmapFormat8Bit);
+    // rows around the screen catch scanlines written off screen
+    struct scanline *scanlines = malloc((h + 2 * FUZZ_MARGIN) *
+                                        sizeof(struct scanline));
+    int errors = 0;
+
+    for (int it = 0; it < iterations; ++it)
+    {
+        int cx0 = rnd(bounds.size.w / 3);
+        int cy0 = rnd(h / 3);
+        int cx1 = bounds.size.w - rnd(bounds.size.w / 3);
+        int cy1 = h - rnd(h / 3);
+        set_clip_rect(cx0, cy0, cx1, cy1);
+        set_antialias(rnd(4) != 0);
+        memset(gbitmap_get_data(bmp), FILL, (size_t)stride * h);
+        for (int y = 0; y < h + 2 * FUZZ_MARGIN; ++y)
+            scanlines[y] = (struct scanline){ 1000, -1000 };
+
+        int prim = it % NUM_FUZZ;
+        draw(bmp, scanlines + FUZZ_MARGIN, prim, &font, sprite);
+
+        for (int y = -FUZZ_MARGIN; y < h + FUZZ_MARGIN; ++y)
+        {
+            int bad = 0;
+            const struct scanline *s = &scanlines[y + FUZZ_MARGIN];
+            bool inside = y >= cy0 && y < cy1;
+            if (! inside && (s->start != 1000 || s->end != -1000))
+                bad = 1;
+            if (y >= 0 && y < h)
+            {
+                GBitmapDataRowInfo row = gbitmap_get_data_row_info(bmp, y);
+                int x0 = row.min_x > cx0 ? row.min_x : cx0;
+                int x1 = row.max_x + 1 < cx1 ? row.max_x + 1 : cx1;
+                bad += check_row(gbitmap_get_data(bmp) + y * stride, stride,
+                                 bits, inside ? x0 : 0, inside ? x1 : 0);
+            }
+            if (bad && errors++ < MAX_ERRORS)
+                printf("%-8s %s %d: %d pixels written in row %d, clip "
+                       "%d %d %d %d\n", host_platform->name, names[prim], it,
+                       bad, y, cx0, cy0, cx1, cy1);
+        }
+    }
+    if (errors)
+        ++*failures;
+    printf("%-8s %d iterations, %d rows with errors\n", host_platform->name,
+           iterations, errors);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        iterations = atoi(argv[1]);
+    failures = host_shared(sizeof(*failures));
+    for (int i = 0; i < host_num_platforms; ++i)
+        if (host_built_for(&host_platforms[i]) &&
+            host_launch(&host_platforms[i], run) != 0)
+        {
+            printf("%-8s crashed\n", host_platforms[i].name);
+            ++*failures;
+        }
+    return *failures != 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * Reference coverage of rects, strips and circles in floating point, compared
+ * to what the bg kernels of the rasterizer draw. Polygons are clipped to each
+ * pixel and their area is exact, circles are sampled ORACLE_SAMPLES^2 times
+ * per pixel. The area is quantized to the levels 0 to 4 the kernels blend
+ * with, and compared to the levels the bg kernels draw with ORACLE_COLORS.
+ * Built with rasterizer.c alone, against a plain 8 bit bitmap.
+ *
+ * The exit status is 1 if an anti-aliased pixel is off by more than
+ * ORACLE_MAX_ERROR levels. Aliased pixels are either 0 or 4, their errors
+ * are only reported.
+ */
+
+#include "rasterizer.h"
+
+#include <pebble.h>
+
+#include <math.h>
+#include <time.h>
+
+#define ORACLE_BG 0xC0
+#define ORACLE_COLORS 0xC4C3C2C1
+#define ORACLE_SAMPLES 16
+#define ORACLE_TESTS 24
+#define ORACLE_REPS 100
+#define ORACLE_MAX_ERROR 2
+
+#define ORACLE_SIZE 180
+
+struct GBitmap
+{
+    uint8_t *data;
+    int16_t w, h;
+};
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap)
+{
+    return GRect(0, 0, bitmap->w, bitmap->h);
+}
+
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap)
+{
+    return GBitmapFormat8Bit;
+}
+
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap,
+                                             uint16_t y)
+{
+    if (y >= bitmap->h)
+        abort();
+    return (GBitmapDataRowInfo){ bitmap->data + y * bitmap->w, 0,
+                                 bitmap->w - 1 };
+}
+
+struct fpoint
+{
+    float x, y;
+};
+
+struct oracle_error
+{
+    uint32_t pixels, differing, sum, max;
+    uint64_t ns;
+};
+
+// distance inside of a side of the pixel at (x, y)
+static inline float pixel_side(const struct fpoint *p, int side, int x, int y)
+{
+    switch (side)
+    {
+    case 0: return p->x - x;
+    case 1: return x + 1 - p->x;
+    case 2: return p->y - y;
+    default: return y + 1 - p->y;
+    }
+}
+
+// area of a convex quad clipped to the pixel at (x, y)
+static float clipped_area(const struct fpoint *pts, int x, int y)
+{
+    struct fpoint a[8], b[8];
+    int n = 4;
+    memcpy(a, pts, n * sizeof(*a));
+    for (int side = 0; side < 4 && n > 0; ++side)
+    {
+        int m = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            const struct fpoint *p = a + i;
+            const struct fpoint *q = a + (i + 1 < n ? i + 1 : 0);
+            float dp = pixel_side(p, side, x, y);
+            float dq = pixel_side(q, side, x, y);
+            if (dp >= 0) b[m++] = *p;
+            if ((dp >= 0) != (dq >= 0))
+            {
+                float t = dp / (dp - dq);
+                b[m].x = p->x + t * (q->x - p->x);
+                b[m++].y = p->y + t * (q->y - p->y);
+            }
+        }
+        memcpy(a, b, m * sizeof(*a));
+        n = m;
+    }
+
+    float area = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        const struct fpoint *p = a + i;
+        const struct fpoint *q = a + (i + 1 < n ? i + 1 : 0);
+        area += p->x * q->y - q->x * p->y;
+    }
+    return (area < 0 ? -area : area) / 2;
+}
+
+static float circle_area(float cx, float cy, float r, int x, int y)
+{
+    int n = 0;
+    for (int i = 0; i < ORACLE_SAMPLES; ++i)
+    {
+        float dy = y + (i + 0.5f) / ORACLE_SAMPLES - cy;
+        for (int j = 0; j < ORACLE_SAMPLES; ++j)
+        {
+            float dx = x + (j + 0.5f) / ORACLE_SAMPLES - cx;
+            if (dx * dx + dy * dy <= r * r) ++n;
+        }
+    }
+    return (float)n / (ORACLE_SAMPLES * ORACLE_SAMPLES);
+}
+
+static inline int clampi(int v, int lo, int hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+// compares the pixels in [x0, x1) x [y0, y1) and clears them again
+static void compare_coverage(GBitmap *bmp, struct oracle_error *err,
+                             const struct fpoint *quad, float cx, float cy,
+                             float r, int x0, int y0, int x1, int y1)
+{
+    for (int y = clampi(y0, 0, bmp->h); y < clampi(y1, 0, bmp->h); ++y)
+    {
+        uint8_t *line = bmp->data + y * bmp->w;
+        for (int x = clampi(x0, 0, bmp->w); x < clampi(x1, 0, bmp->w); ++x)
+        {
+            float area = quad ? clipped_area(quad, x, y) :
+                circle_area(cx, cy, r, x, y);
+            int ref = (int)(area * 4 + 0.5f);
+            int level = line[x] - ORACLE_BG;
+            int d = level > ref ? level - ref : ref - level;
+            if (ref || level) ++err->pixels;
+            if (d) ++err->differing;
+            err->sum += d;
+            if (err->max < (uint32_t)d) err->max = d;
+            line[x] = ORACLE_BG;
+        }
+    }
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool report(const char *name, bool aa, const struct oracle_error *err)
+{
+    printf("%-6s %-7s mean %4d/1000, max %d, %4d of %5d differ, %5d ns\n",
+           name, aa ? "aa" : "aliased",
+           (int)(err->sum * 1000 / (err->pixels ? err->pixels : 1)),
+           (int)err->max, (int)err->differing, (int)err->pixels,
+           (int)(err->ns / (ORACLE_TESTS * ORACLE_REPS)));
+    return ! aa || err->max <= ORACLE_MAX_ERROR;
+}
+
+static void draw_strip(GBitmap *bmp, struct scanline *scanlines, bool steep,
+                       int32_t px, int32_t py, int32_t dx, int32_t dy,
+                       int32_t len, int32_t w)
+{
+    if (steep)
+        draw_vstrip(bmp, scanlines, ORACLE_COLORS, px, py, dx, dy, len, w);
+    else
+        draw_hstrip(bmp, scanlines, ORACLE_COLORS, px, py, dx, dy, len, w);
+}
+
+// the area a primitive reaching ext from (px, py) can touch
+static void box(int32_t px, int32_t py, int32_t ext, int *x0, int *y0,
+                int *x1, int *y1)
+{
+    int e = (ext + 0xF) >> FIXED_SHIFT;
+    *x0 = (px >> FIXED_SHIFT) - e - 3;
+    *x1 = (px >> FIXED_SHIFT) + e + 3;
+    *y0 = (py >> FIXED_SHIFT) - e - 3;
+    *y1 = (py >> FIXED_SHIFT) + e + 3;
+}
+
+int main(void)
+{
+    static uint8_t pixels[ORACLE_SIZE * ORACLE_SIZE];
+    static struct scanline scanlines[ORACLE_SIZE];
+    GBitmap bmp = { pixels, ORACLE_SIZE, ORACLE_SIZE };
+    int w = ORACLE_SIZE, h = ORACLE_SIZE;
+    bool ok = true;
+
+    set_clip_rect(0, 0, w, h);
+    memset(pixels, ORACLE_BG, sizeof(pixels));
+
+    for (int aa = 1; aa >= 0; --aa)
+    {
+        set_antialias(aa);
+        struct oracle_error rect = { 0 }, strip = { 0 }, circle = { 0 };
+
+        for (int i = 0; i < ORACLE_TESTS; ++i)
+        {
+            // steep and shallow directions for the strips
+            double a = (i + 37.0 * i / TRIG_MAX_ANGLE) * 2 * M_PI /
+                ORACLE_TESTS;
+            int32_t dx = (int32_t)lround(sin(a) * fixed(256));
+            int32_t dy = (int32_t)lround(-cos(a) * fixed(256));
+            int32_t px = fixed(w / 2) + (i * 5) % 16;
+            int32_t py = fixed(h / 2) + (i * 11) % 16;
+            int32_t len = fixed(12 + i % 4 * 6) + i % 3 * 5;
+            int32_t hw = fixed(1) / 2 + i * 3;
+            float fx = px / 16.0f, fy = py / 16.0f;
+            float ux = dx / 4096.0f, uy = dy / 4096.0f;
+            float fw = hw / 16.0f, fl = len / 16.0f;
+            int x0, y0, x1, y1;
+            box(px, py, len + hw, &x0, &y0, &x1, &y1);
+
+            struct fpoint quad[4] = {
+                { fx - fw * uy, fy + fw * ux },
+                { fx - fw * uy + fl * ux, fy + fw * ux + fl * uy },
+                { fx + fw * uy + fl * ux, fy - fw * ux + fl * uy },
+                { fx + fw * uy, fy - fw * ux },
+            };
+            draw_bg_rect(&bmp, scanlines, ORACLE_COLORS, px, py, dx, dy,
+                         len, hw);
+            compare_coverage(&bmp, &rect, quad, 0, 0, 0, x0, y0, x1, y1);
+            uint64_t start = now_ns();
+            for (int j = 0; j < ORACLE_REPS; ++j)
+                draw_bg_rect(&bmp, scanlines, ORACLE_COLORS, px, py, dx, dy,
+                             len, hw);
+            rect.ns += now_ns() - start;
+            memset(pixels, ORACLE_BG, sizeof(pixels));
+
+            // ends of the strip are on the rows or columns of the rect ends
+            bool steep = (dy < 0 ? -dy : dy) > (dx < 0 ? -dx : dx);
+            float ex = fx + fl * ux, ey = fy + fl * uy;
+            if (steep)
+            {
+                float o = fw / (uy < 0 ? -uy : uy);
+                struct fpoint vquad[4] = {
+                    { fx - o, fy }, { ex - o, ey }, { ex + o, ey }, { fx + o, fy },
+                };
+                memcpy(quad, vquad, sizeof(quad));
+            }
+            else
+            {
+                float o = fw / (ux < 0 ? -ux : ux);
+                struct fpoint hquad[4] = {
+                    { fx, fy - o }, { ex, ey - o }, { ex, ey + o }, { fx, fy + o },
+                };
+                memcpy(quad, hquad, sizeof(quad));
+            }
+            draw_strip(&bmp, scanlines, steep, px, py, dx, dy, len, hw);
+            compare_coverage(&bmp, &strip, quad, 0, 0, 0, x0, y0, x1, y1);
+            start = now_ns();
+            for (int j = 0; j < ORACLE_REPS; ++j)
+                draw_strip(&bmp, scanlines, steep, px, py, dx, dy, len, hw);
+            strip.ns += now_ns() - start;
+            memset(pixels, ORACLE_BG, sizeof(pixels));
+
+            int32_t r = fixed(2 + i % 8 * 3) + (i * 7) % 16;
+            box(px, py, r, &x0, &y0, &x1, &y1);
+            draw_bg_circle(&bmp, ORACLE_COLORS, px, py, r);
+            compare_coverage(&bmp, &circle, NULL, fx, fy, r / 16.0f,
+                             x0, y0, x1, y1);
+            start = now_ns();
+            for (int j = 0; j < ORACLE_REPS; ++j)
+                draw_bg_circle(&bmp, ORACLE_COLORS, px, py, r);
+            circle.ns += now_ns() - start;
+            memset(pixels, ORACLE_BG, sizeof(pixels));
+        }
+
+        ok &= report("rect", aa, &rect);
+        ok &= report("strip", aa, &strip);
+        ok &= report("circle", aa, &circle);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+/*
+ * Time to the first frame of a relaunch, with and without the warm-start
+ * record of the last launch, on each platform of this build. The first launch
+ * sets a location, so a cold start calculates the sun times. Each time is the
+ * fastest of RELAUNCH_ROUNDS launches, they are wall times of the host.
+ */
+
+#include "host.h"
+
+#include <unistd.h>
+
+// as placidial.c stores the record
+#define WARMSTART_KEY 24
+
+#define RELAUNCH_ROUNDS 20
+
+// 13.4 E, 52.5 N in units of TRIG_MAX_ANGLE, for sun times
+#define RELAUNCH_LOCATION "longitude=2439,latitude=9557"
+
+static void configure(void)
+{
+    host_push("colorflip=1");
+    host_push(RELAUNCH_LOCATION);
+}
+
+// fastest first frame of launches from the storage in path
+static int first_frame(const struct host_platform *p, const char *path,
+                       bool warm)
+{
+    uint32_t best = UINT32_MAX;
+    for (int i = 0; i < RELAUNCH_ROUNDS; ++i)
+    {
+        host_persist_load(path);
+        if (! warm)
+            persist_delete(WARMSTART_KEY);
+        if (host_launch(p, NULL) != 0)
+            return -1;
+        if (host_stats->first_frame_us < best)
+            best = host_stats->first_frame_us;
+    }
+    return best;
+}
+
+int main(void)
+{
+    char path[] = "/tmp/relaunchXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        perror(path);
+        return 2;
+    }
+    close(fd);
+
+    int status = 0;
+    for (int i = 0; i < host_num_platforms; ++i)
+    {
+        const struct host_platform *p = &host_platforms[i];
+        if (! host_built_for(p))
+            continue;
+        host_persist_clear();
+        if (host_launch(p, configure) != 0 ||
+            persist_get_size(WARMSTART_KEY) <= 0 ||
+            ! host_persist_save(path))
+        {
+            printf("%-8s no warm-start record\n", p->name);
+            status = 1;
+            continue;
+        }
+        int cold = first_frame(p, path, false);
+        int warm = first_frame(p, path, true);
+        if (cold < 0 || warm < 0)
+        {
+            printf("%-8s crashed\n", p->name);
+            status = 1;
+            continue;
+        }
+        printf("%-8s first frame %5d us cold, %5d us warm\n", p->name, cold,
+               warm);
+    }
+    unlink(path);
+    return status;
+}
@@ -0,0 +1,180 @@
+/*
+ * Records a session of inputs with the TRACE=1 build of the watchface, and
+ * replays the persisted trace with the TRACE=2 build on each platform of it.
+ * Each replayed input is timed by the frames it draws, with the fastest of
+ * REPLAY_ROUNDS launches, so the timings repeat from run to run.
+ *
+ *   trace_record trace
+ *   trace_replay trace
+ *
+ * trace is the persist storage of the launch, see host_persist_save().
+ */
+
+#include "host.h"
+
+// as placidial.c stores the trace
+#define TRACE_PERSIST_KEY 0x1000
+#define TRACE_CHUNKS 8
+#define TRACE_SIZE (TRACE_CHUNKS * PERSIST_DATA_MAX_LENGTH)
+#define TRACE_RECORD_HEADER 3
+#define TRACE_REPLAY_MS 100
+
+#define REPLAY_ROUNDS 5
+#define MAX_RECORDS (TRACE_SIZE / TRACE_RECORD_HEADER)
+
+#if TRACE == 1
+// a day of minute ticks with the status, taps and settings in between
+static void record(void)
+{
+    host_push(HOST_CLAY_SETTINGS);
+    for (int i = 0; i < 72; ++i)
+    {
+        host_tick(HOST_EPOCH + i * 20 * 60, SECOND_UNIT | MINUTE_UNIT |
+                  (i % 3 == 0 ? HOUR_UNIT : 0));
+        if (i % 12 == 5)
+            host_tap();
+        if (i % 24 == 10)
+            host_battery(80 - i, i == 58);
+        if (i == 30)
+            host_connection(false);
+        if (i == 31)
+            host_connection(true);
+        if (i == 40)
+            host_push("outline=0");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s trace\n", argv[0]);
+        return 2;
+    }
+    host_persist_clear();
+    if (host_launch(host_find_platform("basalt"), record) != 0)
+        return 1;
+    if (! host_persist_save(argv[1]))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    return 0;
+}
+#else
+static const char *const types[] = {
+    "wrap", "tick", "connection", "message", "tap", "battery",
+};
+
+static uint8_t buf[TRACE_SIZE];
+static int num_records;
+static uint8_t record_types[MAX_RECORDS];
+// fastest thread time of the frames of each record
+static uint32_t *record_us;
+
+// walks the records from the oldest, as the replay does
+static void read_trace(void)
+{
+    uint16_t header[2] = { 0, 0 };
+    persist_read_data(TRACE_PERSIST_KEY, header, sizeof(header));
+    for (int i = 0; i < TRACE_CHUNKS; ++i)
+        persist_read_data(TRACE_PERSIST_KEY + 1 + i,
+                          buf + i * PERSIST_DATA_MAX_LENGTH,
+                          PERSIST_DATA_MAX_LENGTH);
+    int pos = header[0] < TRACE_SIZE ? header[0] : 0;
+    int head = header[1] < TRACE_SIZE ? header[1] : 0;
+    num_records = 0;
+    while (pos != head && num_records < MAX_RECORDS)
+    {
+        if (buf[pos] == 0)
+        {
+            pos = 0;
+            continue;
+        }
+        record_types[num_records++] = buf[pos];
+        pos += TRACE_RECORD_HEADER + buf[pos + 1] + (buf[pos + 2] << 8);
+        if (pos >= TRACE_SIZE)
+            pos = 0;
+    }
+}
+
+static void replay(void)
+{
+    for (int i = 0; i < num_records; ++i)
+    {
+        uint64_t us = host_stats->frame_us;
+        host_advance(TRACE_REPLAY_MS);
+        us = host_stats->frame_us - us;
+        if (us < record_us[i])
+            record_us[i] = us;
+    }
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s trace\n", argv[0]);
+        return 2;
+    }
+    if (! host_persist_load(argv[1]))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    read_trace();
+    if (! num_records)
+    {
+        fprintf(stderr, "%s: no trace\n", argv[1]);
+        return 1;
+    }
+    record_us = host_shared(MAX_RECORDS * sizeof(*record_us));
+
+    int status = 0;
+    for (int i = 0; i < host_num_platforms; ++i)
+    {
+        const struct host_platform *p = &host_platforms[i];
+        if (! host_built_for(p))
+            continue;
+        memset(record_us, 0xFF, MAX_RECORDS * sizeof(*record_us));
+        for (int round = 0; round < REPLAY_ROUNDS; ++round)
+        {
+            // the replay does not move the tail in persist storage, but the
+            // launch may write its settings
+            host_persist_load(argv[1]);
+            if (host_launch(p, replay) != 0)
+            {
+                printf("%-8s crashed\n", p->name);
+                status = 1;
+                break;
+            }
+        }
+
+        static uint32_t sorted[MAX_RECORDS];
+        memcpy(sorted, record_us, num_records * sizeof(*sorted));
+        qsort(sorted, num_records, sizeof(*sorted), cmp_u32);
+        uint64_t total = 0;
+        int slowest = 0;
+        for (int j = 0; j < num_records; ++j)
+        {
+            total += record_us[j];
+            if (record_us[j] > record_us[slowest])
+                slowest = j;
+        }
+        printf("%-8s %3d inputs, %6d us, p50 %4d us, p99 %4d us, "
+               "max %4d us (%s %d)\n", p->name, num_records, (int)total,
+               (int)sorted[num_records / 2],
+               (int)sorted[(num_records - 1) * 99 / 100],
+               (int)record_us[slowest],
+               record_types[slowest] < sizeof(types) / sizeof(*types) ?
+               types[record_types[slowest]] : "?", slowest);
+    }
+    return status;
+}
+#endif
@@ -0,0 +1,131 @@
+/*
+ * The simulated watch behind the stub SDK. A driver launches the watchface on
+ * one of the platforms and feeds it inputs, while the watch keeps a virtual
+ * clock, draws a frame whenever the window is dirty and counts what the
+ * watchface did.
+ */
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <pebble.h>
+
+struct host_platform
+{
+    const char *name;
+    int16_t w, h;
+    bool round;
+    // 1 bit frame buffer, the watchface must be built with PBL_BW
+    bool bw;
+    // resources converted to 1 bit, instead of 2 bit palettes
+    bool bw_resources;
+    // height of the timeline quick view, 0 without one
+    int16_t obstruction;
+};
+
+extern const struct host_platform host_platforms[];
+extern const int host_num_platforms;
+
+// NULL for an unknown name
+const struct host_platform *host_find_platform(const char *name);
+
+// the platforms of this build, color or PBL_BW
+static inline bool host_built_for(const struct host_platform *p)
+{
+#ifdef PBL_BW
+    return p->bw;
+#else
+    return ! p->bw;
+#endif
+}
+
+// images of the resources, 8 bit gray packed to 2 bits per pixel
+struct host_resource
+{
+    const char *name;
+    int16_t w, h;
+    uint16_t stride;
+    const uint8_t *data;
+};
+
+extern const struct host_resource host_resources[];
+extern const int host_num_resources;
+
+// counters of a launch, they survive its process
+struct host_stats
+{
+    uint32_t frames;
+    uint32_t dirty;
+    uint32_t persist_writes;
+    uint32_t resource_loads;
+    uint32_t messages_sent;
+    // bytes written outside of the visible part of rows, or the bitmap
+    uint32_t oob;
+    // from the launch to the end of the first frame
+    uint32_t first_frame_us;
+    // thread time of all frames
+    uint64_t frame_us;
+    // pixels which differ from the frame before, summed over the frames
+    uint64_t pixels;
+};
+
+extern struct host_stats *host_stats;
+
+// zeroed memory shared with launches, since each runs in its own process
+void *host_shared(size_t size);
+
+/*
+ * Runs placidial_main, the watchface's main, on platform p in a child process,
+ * so every launch starts from a fresh state. Once the first frame is drawn,
+ * app_event_loop calls run, the watchface is deinitialized when it returns.
+ * Persist storage and host_stats are shared with the caller. Returns the exit
+ * status of the child.
+ */
+int host_launch(const struct host_platform *p, void (*run)(void));
+
+// the platform of the running launch
+extern const struct host_platform *host_platform;
+
+// draws a frame if the window is dirty, returns its time in us or -1
+int host_frame(void);
+GBitmap *host_framebuffer(void);
+// hash of the visible pixels of the last frame
+uint64_t host_frame_hash(void);
+// pixel of the last frame, as 8 bit color
+uint8_t host_pixel(int x, int y);
+// writes the last frame as PPM, scaled up by scale
+bool host_write_ppm(const char *path, int scale);
+
+// monotonic time of the host in us
+uint64_t host_us(void);
+
+// the watch starts its clock at 2026-07-17 00:00:00 UTC
+#define HOST_EPOCH 1784246400
+
+// virtual time in ms since the epoch
+uint64_t host_now_ms(void);
+// fires timers and ticks until ms later, drawing a frame after each
+void host_advance(uint32_t ms);
+// jumps to time t and ticks with units, if subscribed
+void host_tick(time_t t, TimeUnits units);
+// virtual time a frame takes, as seen by time_ms()
+void host_set_frame_ms(uint32_t ms);
+
+// settings as "key=value,..." with the names of the message keys, sent like
+// the config page does, values in double quotes as strings.
+// HOST_CLAY_SETTINGS holds the defaults of the config page.
+void host_push(const char *settings);
+// a serialized dictionary
+void host_push_buffer(const uint8_t *buffer, uint16_t size);
+void host_connection(bool connected);
+void host_battery(uint8_t percent, bool charging);
+void host_tap(void);
+// obstructs the bottom h rows, as the quick view does
+void host_obstruct(int h);
+
+// persist storage as a file, the format is only read by these functions
+bool host_persist_load(const char *path);
+bool host_persist_save(const char *path);
+void host_persist_clear(void);
+
+#endif
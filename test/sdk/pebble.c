@@ -0,0 +1,1210 @@
+/*
+ * Stub SDK on a simulated watch, see host.h. Only what the watchface uses is
+ * implemented, close enough to the SDK that its drawing, settings and
+ * persist storage behave as on the watch.
+ */
+
+#include "host.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+const struct host_platform host_platforms[] = {
+    { "aplite", 144, 168, false, true, true, 0 },
+    { "basalt", 144, 168, false, false, false, 51 },
+    { "chalk", 180, 180, true, false, false, 0 },
+    { "diorite", 144, 168, false, true, false, 51 },
+    { "emery", 200, 228, false, false, false, 68 },
+};
+
+const int host_num_platforms = ARRAY_LENGTH(host_platforms);
+
+const struct host_platform *host_platform;
+struct host_stats *host_stats;
+
+const struct host_platform *host_find_platform(const char *name)
+{
+    for (int i = 0; i < host_num_platforms; ++i)
+        if (! strcmp(host_platforms[i].name, name))
+            return &host_platforms[i];
+    return NULL;
+}
+
+void app_log(uint8_t level, const char *filename, int line,
+             const char *fmt, ...)
+{
+    static int enabled = -1;
+    if (enabled < 0)
+        enabled = getenv("HOST_LOG") != NULL;
+    if (! enabled)
+        return;
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s:%d: ", filename, line);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+void *host_shared(size_t size)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        perror("mmap");
+        exit(2);
+    }
+    return p;
+}
+
+uint64_t host_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// time
+
+static uint64_t clock_ms = (uint64_t)HOST_EPOCH * 1000;
+static uint32_t frame_ms;
+
+uint64_t host_now_ms(void)
+{
+    return clock_ms;
+}
+
+void host_set_frame_ms(uint32_t ms)
+{
+    frame_ms = ms;
+}
+
+time_t host_time(time_t *t)
+{
+    time_t now = clock_ms / 1000;
+    if (t) *t = now;
+    return now;
+}
+
+uint16_t time_ms(time_t *t, uint16_t *ms)
+{
+    uint16_t m = clock_ms % 1000;
+    host_time(t);
+    if (ms) *ms = m;
+    return m;
+}
+
+bool clock_is_24h_style(void)
+{
+    return true;
+}
+
+int32_t sin_lookup(int32_t angle)
+{
+    return (int32_t)lround(sin(angle * 2 * M_PI / TRIG_MAX_ANGLE) *
+                           TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle)
+{
+    return (int32_t)lround(cos(angle * 2 * M_PI / TRIG_MAX_ANGLE) *
+                           TRIG_MAX_RATIO);
+}
+
+int32_t atan2_lookup(int16_t y, int16_t x)
+{
+    double a = atan2(y, x);
+    if (a < 0) a += 2 * M_PI;
+    return (int32_t)(a * TRIG_MAX_ANGLE / (2 * M_PI)) % TRIG_MAX_ANGLE;
+}
+
+// graphics
+
+bool grect_equal(const GRect *const rect_a, const GRect *const rect_b)
+{
+    return rect_a->origin.x == rect_b->origin.x &&
+        rect_a->origin.y == rect_b->origin.y &&
+        rect_a->size.w == rect_b->size.w && rect_a->size.h == rect_b->size.h;
+}
+
+void grect_clip(GRect *const rect_to_clip, const GRect *const rect_clipper)
+{
+    GRect *r = rect_to_clip;
+    const GRect *c = rect_clipper;
+    int x0 = r->origin.x > c->origin.x ? r->origin.x : c->origin.x;
+    int y0 = r->origin.y > c->origin.y ? r->origin.y : c->origin.y;
+    int x1 = r->origin.x + r->size.w;
+    int y1 = r->origin.y + r->size.h;
+    if (x1 > c->origin.x + c->size.w) x1 = c->origin.x + c->size.w;
+    if (y1 > c->origin.y + c->size.h) y1 = c->origin.y + c->size.h;
+    *r = GRect(x0, y0, x1 > x0 ? x1 - x0 : 0, y1 > y0 ? y1 - y0 : 0);
+}
+
+GColor8 GColorFromHEX(uint32_t hex)
+{
+    GColor8 c = {
+        .argb = 0xC0 | ((hex >> 22) & 3) << 4 | ((hex >> 14) & 3) << 2 |
+            ((hex >> 6) & 3),
+    };
+    return c;
+}
+
+// bytes around the pixels of bitmaps, filled with FILL to find stray writes
+#define GUARD 64
+#define FILL 0x5A
+
+struct GBitmap
+{
+    uint8_t *alloc;
+    uint8_t *data;
+    int16_t w, h;
+    uint16_t stride;
+    GBitmapFormat format;
+    // visible part of each row of a round display, NULL if all is visible
+    int16_t *min_x, *max_x;
+};
+
+static GBitmap *create_bitmap(int w, int h, int stride, GBitmapFormat format)
+{
+    GBitmap *b = calloc(1, sizeof(*b));
+    b->w = w;
+    b->h = h;
+    b->stride = stride;
+    b->format = format;
+    b->alloc = malloc((size_t)stride * h + 2 * GUARD);
+    memset(b->alloc, FILL, (size_t)stride * h + 2 * GUARD);
+    b->data = b->alloc + GUARD;
+    return b;
+}
+
+static int bytes_per_row(int w, GBitmapFormat format)
+{
+    switch (format)
+    {
+    case GBitmapFormat1Bit: return (w + 31) / 32 * 4;
+    case GBitmapFormat1BitPalette: return (w + 7) / 8;
+    case GBitmapFormat2BitPalette: return (w + 3) / 4;
+    case GBitmapFormat4BitPalette: return (w + 1) / 2;
+    default: return w;
+    }
+}
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id)
+{
+    if (resource_id == 0 || (int)resource_id >= host_num_resources ||
+        ! host_resources[resource_id].data)
+    {
+        fprintf(stderr, "no image resource %u\n", (unsigned)resource_id);
+        abort();
+    }
+    const struct host_resource *res = &host_resources[resource_id];
+    ++host_stats->resource_loads;
+
+    GBitmap *b;
+    if (host_platform->bw_resources)
+    {
+        // converted to 1 bit as on aplite, white is 1 and the first pixel is
+        // the lowest bit
+        b = create_bitmap(res->w, res->h,
+                          bytes_per_row(res->w, GBitmapFormat1Bit),
+                          GBitmapFormat1Bit);
+        memset(b->data, 0, (size_t)b->stride * b->h);
+        for (int y = 0; y < res->h; ++y)
+            for (int x = 0; x < res->w; ++x)
+            {
+                int v = res->data[y * res->stride + x / 4] >>
+                    (6 - (x & 3) * 2) & 3;
+                if (v >= 2)
+                    b->data[y * b->stride + x / 8] |= 1 << (x & 7);
+            }
+    }
+    else
+    {
+        b = create_bitmap(res->w, res->h, res->stride,
+                          GBitmapFormat2BitPalette);
+        memcpy(b->data, res->data, (size_t)res->stride * res->h);
+    }
+    return b;
+}
+
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format)
+{
+    GBitmap *b = create_bitmap(size.w, size.h, bytes_per_row(size.w, format),
+                               format);
+    memset(b->data, 0, (size_t)b->stride * b->h);
+    return b;
+}
+
+void gbitmap_destroy(GBitmap *bitmap)
+{
+    if (! bitmap)
+        return;
+    free(bitmap->alloc);
+    free(bitmap->min_x);
+    free(bitmap->max_x);
+    free(bitmap);
+}
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap)
+{
+    return bitmap->data;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap)
+{
+    return bitmap->stride;
+}
+
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap)
+{
+    return bitmap->format;
+}
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap)
+{
+    return GRect(0, 0, bitmap->w, bitmap->h);
+}
+
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap,
+                                             uint16_t y)
+{
+    if (y >= bitmap->h)
+    {
+        fprintf(stderr, "row %d of a bitmap of %d rows\n", y, bitmap->h);
+        abort();
+    }
+    GBitmapDataRowInfo info = {
+        .data = bitmap->data + (size_t)y * bitmap->stride,
+        .min_x = bitmap->min_x ? bitmap->min_x[y] : 0,
+        .max_x = bitmap->max_x ? bitmap->max_x[y] : bitmap->w - 1,
+    };
+    return info;
+}
+
+struct GContext
+{
+    GBitmap *framebuffer;
+    bool captured;
+};
+
+static GContext context;
+
+GBitmap *graphics_capture_frame_buffer(GContext *ctx)
+{
+    if (ctx->captured)
+        return NULL;
+    ctx->captured = true;
+    return ctx->framebuffer;
+}
+
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer)
+{
+    ctx->captured = false;
+    clock_ms += frame_ms;
+    return buffer == ctx->framebuffer;
+}
+
+GBitmap *host_framebuffer(void)
+{
+    return context.framebuffer;
+}
+
+// round displays show a circle, rows are cut at its edge
+static void init_framebuffer(const struct host_platform *p)
+{
+    GBitmap *b;
+    if (p->bw)
+        b = create_bitmap(p->w, p->h, bytes_per_row(p->w, GBitmapFormat1Bit),
+                          GBitmapFormat1Bit);
+    else if (p->round)
+    {
+        // rows are padded, so writes past the circle can be found
+        b = create_bitmap(p->w, p->h, p->w + GUARD, GBitmapFormat8BitCircular);
+        b->min_x = malloc(p->h * sizeof(int16_t));
+        b->max_x = malloc(p->h * sizeof(int16_t));
+        for (int y = 0; y < p->h; ++y)
+        {
+            double r = p->w / 2.0;
+            double dy = y + 0.5 - p->h / 2.0;
+            double dx = sqrt(r * r - dy * dy);
+            int x0 = (int)floor(r - dx);
+            int x1 = (int)ceil(r + dx) - 1;
+            b->min_x[y] = x0 > 0 ? x0 : 0;
+            b->max_x[y] = x1 < p->w - 1 ? x1 : p->w - 1;
+        }
+    }
+    else
+        b = create_bitmap(p->w, p->h, p->w + GUARD, GBitmapFormat8Bit);
+    context.framebuffer = b;
+}
+
+static bool visible(const GBitmap *b, int x, int y)
+{
+    return x < b->w && (! b->min_x || (x >= b->min_x[y] && x <= b->max_x[y]));
+}
+
+uint8_t host_pixel(int x, int y)
+{
+    const GBitmap *b = context.framebuffer;
+    const uint8_t *row = b->data + (size_t)y * b->stride;
+    if (b->format == GBitmapFormat1Bit)
+        return row[x / 8] >> (x & 7) & 1 ? 0xFF : 0xC0;
+    return row[x];
+}
+
+// counts and restores changed bytes outside the visible pixels
+static uint32_t check_guards(GBitmap *b)
+{
+    uint32_t n = 0;
+    for (int i = 0; i < GUARD; ++i)
+    {
+        uint8_t *after = b->data + (size_t)b->stride * b->h;
+        n += (b->alloc[i] != FILL) + (after[i] != FILL);
+        b->alloc[i] = after[i] = FILL;
+    }
+    for (int y = 0; y < b->h; ++y)
+    {
+        uint8_t *row = b->data + (size_t)y * b->stride;
+        if (b->format == GBitmapFormat1Bit)
+        {
+            for (int x = b->w; x < b->stride * 8; ++x)
+                if ((row[x / 8] ^ FILL) >> (x & 7) & 1)
+                {
+                    ++n;
+                    row[x / 8] ^= 1 << (x & 7);
+                }
+            continue;
+        }
+        for (int x = 0; x < b->stride; ++x)
+            if (! visible(b, x, y) && row[x] != FILL)
+            {
+                ++n;
+                row[x] = FILL;
+            }
+    }
+    return n;
+}
+
+// counts the pixels which differ from the copy of the last frame, and
+// updates the copy
+static uint32_t count_changed(const GBitmap *b)
+{
+    static uint8_t *last;
+    size_t size = (size_t)b->stride * b->h;
+    if (! last)
+        last = calloc(size, 1);
+    uint32_t n = 0;
+    for (int y = 0; y < b->h; ++y)
+    {
+        const uint8_t *row = b->data + (size_t)y * b->stride;
+        uint8_t *copy = last + (size_t)y * b->stride;
+        if (! memcmp(row, copy, b->stride))
+            continue;
+        for (int x = 0; x < b->stride; ++x)
+            n += b->format == GBitmapFormat1Bit ?
+                __builtin_popcount(row[x] ^ copy[x]) : row[x] != copy[x];
+        memcpy(copy, row, b->stride);
+    }
+    return n;
+}
+
+uint64_t host_frame_hash(void)
+{
+    const GBitmap *b = context.framebuffer;
+    uint64_t h = 1469598103934665603ull;
+    for (int y = 0; y < b->h; ++y)
+        for (int x = 0; x < b->w; ++x)
+            if (visible(b, x, y))
+                h = (h ^ host_pixel(x, y)) * 1099511628211ull;
+    return h;
+}
+
+bool host_write_ppm(const char *path, int scale)
+{
+    const GBitmap *b = context.framebuffer;
+    FILE *f = fopen(path, "wb");
+    if (! f)
+        return false;
+    fprintf(f, "P6 %d %d 255\n", b->w * scale, b->h * scale);
+    for (int y = 0; y < b->h * scale; ++y)
+        for (int x = 0; x < b->w * scale; ++x)
+        {
+            uint8_t v = visible(b, x / scale, y / scale) ?
+                host_pixel(x / scale, y / scale) : 0xC0;
+            uint8_t rgb[3] = {
+                (v >> 4 & 3) * 85, (v >> 2 & 3) * 85, (v & 3) * 85,
+            };
+            fwrite(rgb, 1, 3, f);
+        }
+    return fclose(f) == 0;
+}
+
+// windows and layers
+
+struct Layer
+{
+    GRect bounds;
+    GRect unobstructed;
+    LayerUpdateProc update_proc;
+    bool dirty;
+};
+
+struct Window
+{
+    WindowHandlers handlers;
+    Layer root;
+};
+
+static Window *top;
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc)
+{
+    layer->update_proc = update_proc;
+}
+
+void layer_mark_dirty(Layer *layer)
+{
+    layer->dirty = true;
+    ++host_stats->dirty;
+}
+
+GRect layer_get_bounds(const Layer *layer)
+{
+    return layer->bounds;
+}
+
+GRect layer_get_unobstructed_bounds(const Layer *layer)
+{
+    return layer->unobstructed;
+}
+
+Window *window_create(void)
+{
+    Window *window = calloc(1, sizeof(*window));
+    window->root.bounds = GRect(0, 0, host_platform->w, host_platform->h);
+    window->root.unobstructed = window->root.bounds;
+    return window;
+}
+
+void window_destroy(Window *window)
+{
+    if (top == window)
+    {
+        if (window->handlers.unload)
+            window->handlers.unload(window);
+        top = NULL;
+    }
+    free(window);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers)
+{
+    window->handlers = handlers;
+}
+
+Layer *window_get_root_layer(const Window *window)
+{
+    return (Layer *)&window->root;
+}
+
+void window_stack_push(Window *window, bool animated)
+{
+    top = window;
+    if (window->handlers.load)
+        window->handlers.load(window);
+    window->root.dirty = true;
+}
+
+int host_frame(void)
+{
+    if (! top || ! top->root.dirty || ! top->root.update_proc)
+        return -1;
+    top->root.dirty = false;
+
+    struct timespec a, b;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &a);
+    top->root.update_proc(&top->root, &context);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &b);
+
+    if (host_stats->frames++ == 0)
+        host_stats->first_frame_us = host_us() - host_stats->first_frame_us;
+    host_stats->oob += check_guards(context.framebuffer);
+    host_stats->pixels += count_changed(context.framebuffer);
+    int us = (int)((b.tv_sec - a.tv_sec) * 1000000 +
+                   (b.tv_nsec - a.tv_nsec) / 1000);
+    host_stats->frame_us += us;
+    return us;
+}
+
+static UnobstructedAreaHandlers unobstructed_handlers;
+static void *unobstructed_context;
+
+void unobstructed_area_service_subscribe(UnobstructedAreaHandlers handlers,
+                                         void *context)
+{
+    unobstructed_handlers = handlers;
+    unobstructed_context = context;
+}
+
+void unobstructed_area_service_unsubscribe(void)
+{
+    memset(&unobstructed_handlers, 0, sizeof(unobstructed_handlers));
+}
+
+void host_obstruct(int h)
+{
+    if (! top)
+        return;
+    GRect area = top->root.bounds;
+    area.size.h -= h;
+    if (unobstructed_handlers.will_change)
+        unobstructed_handlers.will_change(area, unobstructed_context);
+    top->root.unobstructed = area;
+    if (unobstructed_handlers.change)
+        unobstructed_handlers.change(0xFFFF, unobstructed_context);
+    if (unobstructed_handlers.did_change)
+        unobstructed_handlers.did_change(unobstructed_context);
+}
+
+// event services
+
+static TickHandler tick_handler;
+static TimeUnits tick_units;
+static AccelTapHandler tap_handler;
+static BatteryStateHandler battery_handler;
+static BatteryChargeState battery = { 80, false, false };
+static ConnectionHandler connection_handler;
+static bool connected = true;
+
+void tick_timer_service_subscribe(TimeUnits tick_units_, TickHandler handler)
+{
+    tick_units = tick_units_;
+    tick_handler = handler;
+}
+
+void tick_timer_service_unsubscribe(void)
+{
+    tick_handler = NULL;
+}
+
+static void tick(TimeUnits units)
+{
+    if (! tick_handler || ! (units & tick_units))
+        return;
+    time_t t = host_time(NULL);
+    tick_handler(localtime(&t), units);
+}
+
+void host_tick(time_t t, TimeUnits units)
+{
+    clock_ms = (uint64_t)t * 1000;
+    tick(units);
+}
+
+void accel_tap_service_subscribe(AccelTapHandler handler)
+{
+    tap_handler = handler;
+}
+
+void accel_tap_service_unsubscribe(void)
+{
+    tap_handler = NULL;
+}
+
+void host_tap(void)
+{
+    if (tap_handler)
+        tap_handler(ACCEL_AXIS_Z, 1);
+}
+
+BatteryChargeState battery_state_service_peek(void)
+{
+    return battery;
+}
+
+void battery_state_service_subscribe(BatteryStateHandler handler)
+{
+    battery_handler = handler;
+}
+
+void battery_state_service_unsubscribe(void)
+{
+    battery_handler = NULL;
+}
+
+void host_battery(uint8_t percent, bool charging)
+{
+    battery.charge_percent = percent;
+    battery.is_charging = charging;
+    battery.is_plugged = charging;
+    if (battery_handler)
+        battery_handler(battery);
+}
+
+bool connection_service_peek_pebble_app_connection(void)
+{
+    return connected;
+}
+
+void connection_service_subscribe(ConnectionHandlers conn_handlers)
+{
+    connection_handler = conn_handlers.pebble_app_connection_handler;
+}
+
+void connection_service_unsubscribe(void)
+{
+    connection_handler = NULL;
+}
+
+void host_connection(bool connected_)
+{
+    connected = connected_;
+    if (connection_handler)
+        connection_handler(connected);
+}
+
+bool quiet_time_is_active(void)
+{
+    return false;
+}
+
+void vibes_short_pulse(void)
+{
+}
+
+void vibes_long_pulse(void)
+{
+}
+
+void vibes_double_pulse(void)
+{
+}
+
+// timers
+
+#define MAX_TIMERS 32
+
+struct AppTimer
+{
+    uint64_t due;
+    // registration order, for timers due at the same time
+    uint32_t seq;
+    AppTimerCallback callback;
+    void *data;
+    bool active;
+};
+
+static AppTimer timers[MAX_TIMERS];
+static uint32_t timer_seq;
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback,
+                             void *callback_data)
+{
+    for (int i = 0; i < MAX_TIMERS; ++i)
+        if (! timers[i].active)
+        {
+            timers[i] = (AppTimer){
+                clock_ms + timeout_ms, timer_seq++, callback, callback_data,
+                true,
+            };
+            return &timers[i];
+        }
+    fprintf(stderr, "out of timers\n");
+    abort();
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms)
+{
+    if (! timer_handle->active)
+        return false;
+    timer_handle->due = clock_ms + new_timeout_ms;
+    timer_handle->seq = timer_seq++;
+    return true;
+}
+
+void app_timer_cancel(AppTimer *timer_handle)
+{
+    timer_handle->active = false;
+}
+
+static AppTimer *next_timer(void)
+{
+    AppTimer *next = NULL;
+    for (int i = 0; i < MAX_TIMERS; ++i)
+        if (timers[i].active &&
+            (! next || timers[i].due < next->due ||
+             (timers[i].due == next->due && timers[i].seq < next->seq)))
+            next = &timers[i];
+    return next;
+}
+
+// units which change from second t - 1 to t
+static TimeUnits changed_units(time_t t)
+{
+    struct tm a = *localtime(&(time_t){ t - 1 });
+    struct tm *b = localtime(&t);
+    TimeUnits units = SECOND_UNIT;
+    if (a.tm_min != b->tm_min) units |= MINUTE_UNIT;
+    if (a.tm_hour != b->tm_hour) units |= HOUR_UNIT;
+    if (a.tm_mday != b->tm_mday) units |= DAY_UNIT;
+    if (a.tm_mon != b->tm_mon) units |= MONTH_UNIT;
+    if (a.tm_year != b->tm_year) units |= YEAR_UNIT;
+    return units;
+}
+
+void host_advance(uint32_t ms)
+{
+    uint64_t end = clock_ms + ms;
+    for (;;)
+    {
+        AppTimer *timer = next_timer();
+        uint64_t second = (clock_ms / 1000 + 1) * 1000;
+        if (second <= end && (! timer || second <= timer->due))
+        {
+            clock_ms = second;
+            tick(changed_units(second / 1000));
+        }
+        else if (timer && timer->due <= end)
+        {
+            if (timer->due > clock_ms)
+                clock_ms = timer->due;
+            timer->active = false;
+            timer->callback(timer->data);
+        }
+        else
+            break;
+        host_frame();
+    }
+    if (clock_ms < end)
+        clock_ms = end;
+}
+
+// dictionaries
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *buffer,
+                                  const uint16_t size)
+{
+    if (! iter || ! buffer || size < sizeof(Dictionary))
+        return DICT_INVALID_ARGS;
+    iter->dictionary = (Dictionary *)buffer;
+    iter->dictionary->count = 0;
+    iter->cursor = iter->dictionary->head;
+    iter->end = buffer + size;
+    return DICT_OK;
+}
+
+static DictionaryResult dict_write(DictionaryIterator *iter, uint32_t key,
+                                   TupleType type, const void *data,
+                                   uint16_t size)
+{
+    uint8_t *p = (uint8_t *)iter->cursor;
+    if (p + sizeof(Tuple) + size > (const uint8_t *)iter->end)
+        return DICT_NOT_ENOUGH_STORAGE;
+    iter->cursor->key = key;
+    iter->cursor->type = type;
+    iter->cursor->length = size;
+    memcpy(iter->cursor->value->data, data, size);
+    iter->cursor = (Tuple *)(p + sizeof(Tuple) + size);
+    ++iter->dictionary->count;
+    return DICT_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key,
+                                 const uint8_t *data, const uint16_t size)
+{
+    return dict_write(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter,
+                                    const uint32_t key, const char *cstring)
+{
+    return dict_write(iter, key, TUPLE_CSTRING, cstring, strlen(cstring) + 1);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key,
+                                  const int32_t value)
+{
+    return dict_write(iter, key, TUPLE_INT, &value, sizeof(value));
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter)
+{
+    iter->end = iter->cursor;
+    iter->cursor = iter->dictionary->head;
+    return dict_size(iter);
+}
+
+uint32_t dict_size(DictionaryIterator *iter)
+{
+    return (const uint8_t *)iter->end - (const uint8_t *)iter->dictionary;
+}
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter,
+                                   const uint8_t *buffer, const uint16_t size)
+{
+    iter->dictionary = (Dictionary *)buffer;
+    iter->end = buffer + size;
+    return dict_read_first(iter);
+}
+
+Tuple *dict_read_first(DictionaryIterator *iter)
+{
+    iter->cursor = iter->dictionary->head;
+    if (iter->dictionary->count == 0)
+        return NULL;
+    return iter->cursor;
+}
+
+Tuple *dict_read_next(DictionaryIterator *iter)
+{
+    uint8_t *next = (uint8_t *)iter->cursor + sizeof(Tuple) +
+        iter->cursor->length;
+    if (next + sizeof(Tuple) > (const uint8_t *)iter->end)
+        return NULL;
+    iter->cursor = (Tuple *)next;
+    return iter->cursor;
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key)
+{
+    DictionaryIterator it = *iter;
+    for (Tuple *t = dict_read_first(&it); t; t = dict_read_next(&it))
+        if (t->key == key)
+            return t;
+    return NULL;
+}
+
+// app messages, sending succeeds with the next event while connected
+
+static AppMessageInboxReceived inbox_received;
+static AppMessageOutboxSent outbox_sent;
+static AppMessageOutboxFailed outbox_failed;
+static uint8_t *inbox, *outbox;
+static uint32_t inbox_size, outbox_size;
+static DictionaryIterator outbox_iter;
+static bool outbox_busy;
+
+AppMessageResult app_message_open(const uint32_t size_inbound,
+                                  const uint32_t size_outbound)
+{
+    inbox = realloc(inbox, size_inbound);
+    outbox = realloc(outbox, size_outbound);
+    inbox_size = size_inbound;
+    outbox_size = size_outbound;
+    return APP_MSG_OK;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(
+    AppMessageInboxReceived received_callback)
+{
+    AppMessageInboxReceived old = inbox_received;
+    inbox_received = received_callback;
+    return old;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(
+    AppMessageOutboxSent sent_callback)
+{
+    AppMessageOutboxSent old = outbox_sent;
+    outbox_sent = sent_callback;
+    return old;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(
+    AppMessageOutboxFailed failed_callback)
+{
+    AppMessageOutboxFailed old = outbox_failed;
+    outbox_failed = failed_callback;
+    return old;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator)
+{
+    if (outbox_busy)
+        return APP_MSG_BUSY;
+    dict_write_begin(&outbox_iter, outbox, outbox_size);
+    *iterator = &outbox_iter;
+    return APP_MSG_OK;
+}
+
+static void outbox_done(void *data)
+{
+    outbox_busy = false;
+    if (connected && outbox_sent)
+        outbox_sent(&outbox_iter, NULL);
+    else if (! connected && outbox_failed)
+        outbox_failed(&outbox_iter, APP_MSG_NOT_CONNECTED, NULL);
+}
+
+AppMessageResult app_message_outbox_send(void)
+{
+    if (outbox_busy)
+        return APP_MSG_BUSY;
+    outbox_busy = true;
+    ++host_stats->messages_sent;
+    app_timer_register(0, outbox_done, NULL);
+    return APP_MSG_OK;
+}
+
+void host_push_buffer(const uint8_t *buffer, uint16_t size)
+{
+    if (size > inbox_size)
+    {
+        fprintf(stderr, "message of %d bytes, the inbox has %d\n", size,
+                (int)inbox_size);
+        abort();
+    }
+    memcpy(inbox, buffer, size);
+    DictionaryIterator iter;
+    dict_read_begin_from_buffer(&iter, inbox, size);
+    if (inbox_received)
+        inbox_received(&iter, NULL);
+}
+
+void host_push(const char *settings)
+{
+    static const char *names[] = HOST_MESSAGE_KEYS;
+    uint8_t buffer[1024];
+    DictionaryIterator iter;
+    dict_write_begin(&iter, buffer, sizeof(buffer));
+
+    char *copy = strdup(settings), *save;
+    for (char *s = strtok_r(copy, ",", &save); s;
+         s = strtok_r(NULL, ",", &save))
+    {
+        char *value = strchr(s, '=');
+        int key = 0;
+        if (value)
+            *value++ = 0;
+        while (key < (int)ARRAY_LENGTH(names) && strcmp(names[key], s))
+            ++key;
+        if (! value || key == (int)ARRAY_LENGTH(names))
+        {
+            fprintf(stderr, "bad setting %s\n", s);
+            exit(2);
+        }
+        // quoted values are sent as strings, as Clay does for radio groups
+        size_t n = strlen(value);
+        if (n >= 2 && value[0] == '"' && value[n - 1] == '"')
+        {
+            value[n - 1] = 0;
+            dict_write_cstring(&iter, MESSAGE_KEY_statusshow + key, value + 1);
+        }
+        else
+            dict_write_int32(&iter, MESSAGE_KEY_statusshow + key,
+                             strtol(value, NULL, 0));
+    }
+    free(copy);
+    host_push_buffer(buffer, dict_write_end(&iter));
+}
+
+// persist storage, shared with the launches
+
+#define MAX_PERSIST_KEYS 128
+
+struct persist_entry
+{
+    uint32_t key;
+    int16_t size;
+    bool used;
+    uint8_t data[PERSIST_DATA_MAX_LENGTH];
+};
+
+static struct persist_entry *persist;
+
+static struct persist_entry *persist_find(uint32_t key)
+{
+    for (int i = 0; i < MAX_PERSIST_KEYS; ++i)
+        if (persist[i].used && persist[i].key == key)
+            return &persist[i];
+    return NULL;
+}
+
+bool persist_exists(const uint32_t key)
+{
+    return persist_find(key) != NULL;
+}
+
+int persist_get_size(const uint32_t key)
+{
+    struct persist_entry *e = persist_find(key);
+    return e ? e->size : E_DOES_NOT_EXIST;
+}
+
+int32_t persist_read_int(const uint32_t key)
+{
+    int32_t value = 0;
+    struct persist_entry *e = persist_find(key);
+    if (e && e->size == sizeof(value))
+        memcpy(&value, e->data, sizeof(value));
+    return value;
+}
+
+bool persist_read_bool(const uint32_t key)
+{
+    return persist_read_int(key) != 0;
+}
+
+int persist_read_data(const uint32_t key, void *buffer,
+                      const size_t buffer_size)
+{
+    struct persist_entry *e = persist_find(key);
+    if (! e)
+        return E_DOES_NOT_EXIST;
+    int n = (size_t)e->size < buffer_size ? e->size : (int)buffer_size;
+    memcpy(buffer, e->data, n);
+    return n;
+}
+
+int persist_write_data(const uint32_t key, const void *data,
+                       const size_t size)
+{
+    struct persist_entry *e = persist_find(key);
+    for (int i = 0; ! e && i < MAX_PERSIST_KEYS; ++i)
+        if (! persist[i].used)
+        {
+            e = &persist[i];
+            e->used = true;
+            e->key = key;
+        }
+    if (! e)
+    {
+        fprintf(stderr, "persist storage is full\n");
+        abort();
+    }
+    int n = size < PERSIST_DATA_MAX_LENGTH ? (int)size :
+        PERSIST_DATA_MAX_LENGTH;
+    memcpy(e->data, data, n);
+    e->size = n;
+    ++host_stats->persist_writes;
+    return n;
+}
+
+int persist_write_int(const uint32_t key, const int32_t value)
+{
+    return persist_write_data(key, &value, sizeof(value));
+}
+
+int persist_write_bool(const uint32_t key, const bool value)
+{
+    return persist_write_int(key, value);
+}
+
+int persist_delete(const uint32_t key)
+{
+    struct persist_entry *e = persist_find(key);
+    if (! e)
+        return E_DOES_NOT_EXIST;
+    e->used = false;
+    return 0;
+}
+
+void host_persist_clear(void)
+{
+    memset(persist, 0, MAX_PERSIST_KEYS * sizeof(*persist));
+}
+
+bool host_persist_load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (! f)
+        return false;
+    host_persist_clear();
+    for (int i = 0; i < MAX_PERSIST_KEYS; ++i)
+    {
+        struct persist_entry *e = &persist[i];
+        if (fread(&e->key, sizeof(e->key), 1, f) != 1 ||
+            fread(&e->size, sizeof(e->size), 1, f) != 1 ||
+            e->size < 0 || e->size > PERSIST_DATA_MAX_LENGTH ||
+            fread(e->data, 1, e->size, f) != (size_t)e->size)
+            break;
+        e->used = true;
+    }
+    fclose(f);
+    return true;
+}
+
+bool host_persist_save(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (! f)
+        return false;
+    for (int i = 0; i < MAX_PERSIST_KEYS; ++i)
+    {
+        struct persist_entry *e = &persist[i];
+        if (! e->used)
+            continue;
+        fwrite(&e->key, sizeof(e->key), 1, f);
+        fwrite(&e->size, sizeof(e->size), 1, f);
+        fwrite(e->data, 1, e->size, f);
+    }
+    return fclose(f) == 0;
+}
+
+// app
+
+static void (*launch_run)(void);
+
+void app_event_loop(void)
+{
+    host_frame();
+    if (launch_run)
+        launch_run();
+}
+
+size_t heap_bytes_free(void)
+{
+    return 24 * 1024;
+}
+
+size_t heap_bytes_used(void)
+{
+    return 0;
+}
+
+int placidial_main(void);
+
+__attribute__((constructor))
+static void init_shared(void)
+{
+    host_stats = host_shared(sizeof(*host_stats));
+    persist = host_shared(MAX_PERSIST_KEYS * sizeof(*persist));
+}
+
+int host_launch(const struct host_platform *p, void (*run)(void))
+{
+    memset(host_stats, 0, sizeof(*host_stats));
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        exit(2);
+    }
+    if (pid == 0)
+    {
+        setenv("TZ", "UTC0", 1);
+        tzset();
+        host_platform = p;
+        launch_run = run;
+        init_framebuffer(p);
+        host_stats->first_frame_us = host_us();
+        placidial_main();
+        fflush(NULL);
+        _exit(0);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) < 0)
+        return -1;
+    if (WIFSIGNALED(status))
+    {
+        fprintf(stderr, "%s: killed by signal %d\n", p->name,
+                WTERMSIG(status));
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
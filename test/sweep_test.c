@@ -0,0 +1,66 @@
+/*
+ * Checks that the frame rate of a sweeping second hand follows the render
+ * time: lowered when frames are over budget, clamped to the lowest rate before
+ * falling back to ticking, and raised again once frames are short enough.
+ * Render times are those of the virtual clock, see host_set_frame_ms().
+ */
+
+#include "host.h"
+
+static int *failures;
+
+#define CHECK(cond, ...) ({\
+    if (! (cond)) \
+    { \
+        ++*failures; \
+        printf("%s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+})
+
+// frames per second after settling for seconds
+static int settle(int frame_ms, int seconds)
+{
+    host_set_frame_ms(frame_ms);
+    host_advance(seconds * 1000);
+    uint32_t frames = host_stats->frames;
+    host_advance(2000);
+    return (host_stats->frames - frames) / 2;
+}
+
+static void run_ten(void)
+{
+    host_push("showsec=1,secsweep=10");
+    int fps = settle(0, 2);
+    CHECK(fps == 10, "%d fps at no render time, not 10", fps);
+    // 40 ms leave room for 6 fps with a budget of a quarter of each frame
+    fps = settle(40, 5);
+    CHECK(fps == 6, "%d fps at 40 ms, not 6", fps);
+    // a single slow frame does not count
+    host_set_frame_ms(200);
+    host_advance(150);
+    fps = settle(40, 0);
+    CHECK(fps == 6, "%d fps after one slow frame, not 6", fps);
+    fps = settle(20, 30);
+    CHECK(fps == 10, "%d fps back at 20 ms, not 10", fps);
+}
+
+static void run_five(void)
+{
+    host_push("showsec=1,secsweep=5");
+    int fps = settle(55, 5);
+    CHECK(fps == 4, "%d fps at 55 ms, not 4", fps);
+    fps = settle(100, 5);
+    CHECK(fps == 1, "%d fps at 100 ms, not ticking", fps);
+}
+
+int main(void)
+{
+    failures = host_shared(sizeof(*failures));
+    const struct host_platform *p = host_find_platform("basalt");
+    CHECK(host_launch(p, run_ten) == 0, "crashed at 10 fps");
+    host_persist_clear();
+    CHECK(host_launch(p, run_five) == 0, "crashed at 5 fps");
+    return *failures != 0;
+}